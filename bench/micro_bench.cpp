@@ -0,0 +1,243 @@
+// Microbenchmarks for the pieces of the event path, with Google Benchmark.
+//
+// Each stage is timed on its own with synthetic input: the per-frame
+// transform, frame serialisation, the key/modifier lookup and device rule
+// matching. BM_Replay runs the whole report path into MockUinput and reports
+// writes and events per report next to the time, so a change that saves or
+// adds syscalls shows up as a number rather than only as latency.
+
+#include "../devices.hpp"
+#include "../pipeline.hpp"
+#include "mock_uinput.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace tp3d;
+
+namespace {
+
+constexpr double GAIN = 60.0;
+constexpr int DELTAS = 1024;
+
+// A slow spiral of raw deltas, in device counts, as DeviceInput hands them
+// out (Q16).
+std::vector<ReportDelta> spiral() {
+    std::vector<ReportDelta> v(DELTAS);
+    for (int i = 0; i < DELTAS; ++i) {
+        double a = i * 0.05;
+        double r = 1.0 + (i % 97) * 0.1;
+        v[i].dx = std::lround(r * std::cos(a)) * 65536;
+        v[i].dy = std::lround(r * std::sin(a)) * 65536;
+        if (i % 50 == 0) v[i].wheel = 120;
+    }
+    return v;
+}
+
+struct PipelineFixture {
+    ModeTable modes;
+    CurveSet curves;
+    MotionPipeline pipeline;
+
+    explicit PipelineFixture(const std::vector<std::string>& curve_args) {
+        std::string err;
+        build_modes({}, modes, err);
+        build_curves(curve_args, GAIN, modes, curves, err);
+        pipeline.curves = &curves;
+        pipeline.modes = &modes;
+    }
+};
+
+// Variants: 0 plain, 1 one-euro filter, 2 axis lock, 3 power curve with
+// wheel mapping.
+void BM_PipelineFlush(benchmark::State& state) {
+    const int variant = static_cast<int>(state.range(0));
+    PipelineFixture f(variant == 3 ? std::vector<std::string>{"power:1.6"} : std::vector<std::string>{});
+    std::string err;
+    if (variant == 1) parse_filter_spec("oneeuro:1:0.01", f.pipeline.filter, err);
+    if (variant == 2) parse_axis_lock_spec("0.2", f.pipeline.lock_q16, f.pipeline.release_q16, err);
+    if (variant == 3) parse_wheel_spec("rz:2000", f.pipeline.wheel_axis, f.pipeline.wheel_units, err);
+    const auto deltas = spiral();
+    int64_t t = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        t += 5000;
+        f.pipeline.add(deltas[i], t);
+        MotionFrame mf;
+        benchmark::DoNotOptimize(f.pipeline.flush(static_cast<uint8_t>((i >> 7) % BUILTIN_MODES), mf));
+        benchmark::DoNotOptimize(mf);
+        i = (i + 1) % deltas.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PipelineFlush)->ArgName("variant")->DenseRange(0, 3);
+
+// Two moving axes per frame plus one that repeats its value and is dropped.
+void fill_frame(FrameBuilder& fb, int32_t v) {
+    fb.set_abs(ABS_RX, v);
+    fb.set_abs(ABS_RZ, -v);
+    fb.set_abs(ABS_Y, 0);
+}
+
+void BM_FrameFinish(benchmark::State& state) {
+    FrameBuilder fb;
+    int32_t v = 0;
+    for (auto _ : state) {
+        fill_frame(fb, v = (v + 7) % AXIS_MAX);
+        benchmark::DoNotOptimize(fb.finish());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FrameFinish);
+
+// The real write() path, against /dev/null instead of /dev/uinput.
+void BM_FrameFlushDevNull(benchmark::State& state) {
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        state.SkipWithError("cannot open /dev/null");
+        return;
+    }
+    FrameBuilder fb;
+    int32_t v = 0;
+    const uint64_t calls = Stats::get(g_stats.syscalls);
+    for (auto _ : state) {
+        fill_frame(fb, v = (v + 7) % AXIS_MAX);
+        benchmark::DoNotOptimize(fb.flush(fd));
+    }
+    state.counters["writes/frame"] = benchmark::Counter(
+        static_cast<double>(Stats::get(g_stats.syscalls) - calls) / static_cast<double>(state.iterations()));
+    close(fd);
+}
+BENCHMARK(BM_FrameFlushDevNull);
+
+// A modifier press and release, through KeyState and ChordEngine to the
+// resolved mode, with a hold and a latch chord bound.
+void BM_ModifierLookup(benchmark::State& state) {
+    ModeTable modes;
+    ChordTable chords;
+    std::string err;
+    build_modes({}, modes, err);
+    build_chords({"58=hold:pan;41=latch:tilt"}, KEY_F8, modes, chords, err);
+    KeyState keys;
+    ChordEngine chord;
+    chord.table = &chords;
+    chord.modes = &modes;
+    static const int codes[] = {KEY_LEFTSHIFT, KEY_LEFTCTRL, KEY_CAPSLOCK, KEY_A};
+    int64_t t = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        const int code = codes[i++ & 3];
+        for (int value : {1, 0}) {
+            t += 1000;
+            keys.set(code, value != 0);
+            benchmark::DoNotOptimize(chord.on_key(code, value, t, keys));
+            benchmark::DoNotOptimize(chord.mode);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ModifierLookup);
+
+// A by-id directory of range(0) links, half of them mice, with the wanted
+// device last so every rule scans the whole pool.
+std::vector<Candidate> candidate_pool(int n) {
+    std::vector<Candidate> pool;
+    for (int i = 0; i < n; ++i) {
+        const bool mouse = i % 2 == 0;
+        const bool last = i == n - 1 || i == n - 2;
+        Candidate c;
+        c.base = std::string("usb-Vendor_") + (last ? "ThinkPad_Compact" : "Generic_Device") + "_" + std::to_string(i) +
+                 (mouse ? "-event-mouse" : "-event-kbd");
+        c.path = "/dev/input/by-id/" + c.base;
+        c.origin = "by-id";
+        c.name = last ? "Lenovo ThinkPad Compact USB Keyboard with TrackPoint" : "Generic USB Device";
+        c.has_rel_xy = mouse;
+        c.has_keys = !mouse;
+        pool.push_back(c);
+    }
+    return pool;
+}
+
+void BM_ChooseCandidate(benchmark::State& state) {
+    const auto pool = candidate_pool(static_cast<int>(state.range(0)));
+    const bool keywords = state.range(1) != 0;
+    // Rules that miss, then one that hits on the evdev name only.
+    const std::vector<std::string> rules = keywords ? std::vector<std::string>{}
+                                                    : std::vector<std::string>{"nomatch", "Elan", "usb keyboard with trackpoint"};
+    std::string reason;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(choose_candidate(pool, true, rules, keywords, reason));
+        benchmark::DoNotOptimize(choose_candidate(pool, false, rules, keywords, reason));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ChooseCandidate)->ArgNames({"links", "keywords"})->ArgsProduct({{8, 64}, {0, 1}});
+
+// The daemon's per-report path from raw events to the sink: DeviceInput,
+// MotionPipeline, FrameBuilder and the Output interface, with shift held in
+// alternating stretches.
+void BM_Replay(benchmark::State& state) {
+    PipelineFixture f({});
+    KeyState keys;
+    ChordEngine chord;
+    ChordTable chords;
+    std::string err;
+    build_chords({}, KEY_F8, f.modes, chords, err);
+    chord.table = &chords;
+    chord.modes = &f.modes;
+    chord.resolve(keys);
+    DeviceInput dev;
+    FrameBuilder frame;
+    MockUinput sink;
+    const auto deltas = spiral();
+    std::vector<input_event> events;
+    for (const auto& d : deltas) {
+        input_event ev{};
+        ev.type = EV_REL;
+        ev.code = REL_X;
+        if ((ev.value = static_cast<int32_t>(d.dx >> 16))) events.push_back(ev);
+        ev.code = REL_Y;
+        if ((ev.value = static_cast<int32_t>(d.dy >> 16))) events.push_back(ev);
+        ev.code = REL_WHEEL;
+        if ((ev.value = d.wheel / 120)) events.push_back(ev);
+        ev.type = EV_SYN;
+        ev.code = SYN_REPORT;
+        ev.value = 0;
+        events.push_back(ev);
+    }
+    int64_t t = 0;
+    uint64_t reports = 0;
+    for (auto _ : state) {
+        for (const input_event& ev : events) {
+            ReportDelta rd;
+            if (!dev.feed(ev, rd)) continue;
+            ++reports;
+            t += 5000;
+            if (reports % 400 == 0) {
+                keys.set(KEY_LEFTSHIFT, !keys.is_down(KEY_LEFTSHIFT));
+                chord.on_key(KEY_LEFTSHIFT, keys.is_down(KEY_LEFTSHIFT), t, keys);
+            }
+            f.pipeline.add(rd, t);
+            MotionFrame mf;
+            if (!f.pipeline.flush(chord.mode, mf)) continue;
+            if (mf.mode_changed) for (int axis : ALL_AXES) frame.set_abs(axis, 0);
+            for (int i = 0; i < mf.n; ++i) frame.set_abs(mf.axis[i], mf.value[i]);
+            sink.flush(frame);
+        }
+    }
+    benchmark::DoNotOptimize(sink.checksum);
+    const double n = static_cast<double>(reports);
+    state.SetItemsProcessed(static_cast<int64_t>(reports));
+    state.counters["writes/report"] = benchmark::Counter(static_cast<double>(sink.writes) / n);
+    state.counters["events/report"] = benchmark::Counter(static_cast<double>(sink.events) / n);
+}
+BENCHMARK(BM_Replay);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,26 @@
+#pragma once
+
+// Stand-in for UinputOutput in benchmarks: takes the same frames through the
+// Output interface but only counts what a real device would have been sent,
+// so runs measure the pipeline and report the write() calls it would cost.
+
+#include "../output.hpp"
+
+namespace tp3d {
+
+struct MockUinput : Output {
+    uint64_t writes = 0;  // one per frame that UinputOutput would write()
+    uint64_t events = 0;  // input_events in those writes, SYN_REPORTs included
+    uint64_t checksum = 0;
+
+    int flush(FrameBuilder& fb) override {
+        int n = fb.finish();
+        if (n == 0) return 0;
+        ++writes;
+        events += static_cast<uint64_t>(n);
+        for (int i = 0; i < n; ++i) checksum = checksum * 31 + static_cast<uint32_t>(fb.buf[i].value) + fb.buf[i].code;
+        return n;
+    }
+};
+
+}  // namespace tp3d
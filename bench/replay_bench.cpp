@@ -0,0 +1,385 @@
+// Offline replay benchmark for the motion pipeline.
+//
+// Feeds a --record capture (or a synthetic one) through the same
+// MotionPipeline/FrameBuilder code the daemon runs, without /dev/uinput or
+// root, and reports events/sec and ns per frame. The produced uinput stream
+// can be written out and later compared byte for byte to catch behavioural
+// changes alongside performance regressions. Frames go through MockUinput,
+// so the write() calls the daemon would make are counted too, and
+// --max-writes-per-report / --max-events-per-report fail the run when they
+// exceed a baseline (the ctest gate).
+
+#include "../pipeline.hpp"
+#include "mock_uinput.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace tp3d;
+
+namespace {
+
+constexpr double DEFAULT_GAIN = 60.0;
+
+struct Capture {
+    RecordHeader header{};
+    std::vector<RecordEntry> entries;
+};
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " (<capture>|--synth <reports>) [options]\n\n"
+              << "Options:\n"
+              << "  --gain <float>         Scale factor for deltas (default 60)\n"
+              << "  --curve <spec>         Response curve, as for the daemon (repeatable)\n"
+              << "  --filter <spec>        Smoothing, as for the daemon\n"
+              << "  --mode <spec>          Mode table entries, as for the daemon (repeatable)\n"
+              << "  --chord <spec>         Key bindings, as for the daemon (repeatable; the capture's\n"
+              << "                         hotkey stays the toggle)\n"
+              << "  --wheel <spec>         Scroll wheel mapping, as for the daemon\n"
+              << "  --precision <factor>   Gain factor while a precision chord key is held\n"
+              << "  --axis-lock <spec>     Dominant-axis lock, as for the daemon\n"
+              << "  --rate <Hz>            Pace output like the daemon's --rate (0=per report)\n"
+              << "  --decay-ms <ms>        Spring-back half-life with --rate\n"
+              << "  --predict-ms <ms>      Look-ahead with --rate\n"
+              << "  --iterations <N>       Replay the capture N times (default 20)\n"
+              << "  --write <file>         Write the produced uinput stream\n"
+              << "  --expect <file>        Fail unless the uinput stream matches this file\n"
+              << "  --max-writes-per-report <f>\n"
+              << "                         Fail if the uinput writes per input report exceed f\n"
+              << "  --max-events-per-report <f>\n"
+              << "                         Fail if the uinput events per input report exceed f\n"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+bool load_capture(const std::string& path, Capture& cap) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot open capture: " << path << std::endl;
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&cap.header), sizeof(cap.header)) ||
+        std::memcmp(cap.header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0 || cap.header.version != 1) {
+        std::cerr << "not a trackpoint-3d capture: " << path << std::endl;
+        return false;
+    }
+    RecordEntry e;
+    while (in.read(reinterpret_cast<char*>(&e), sizeof(e))) cap.entries.push_back(e);
+    return true;
+}
+
+// Deterministic stand-in for a real session: capture on, then a slow spiral
+// at 200 Hz with shift/ctrl held in alternating stretches.
+Capture synth_capture(int reports) {
+    Capture cap;
+    std::memcpy(cap.header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    cap.header.version = 1;
+    cap.header.hotkey = KEY_F8;
+    int64_t t = 1000000;
+    auto push = [&](uint8_t src, uint16_t type, uint16_t code, int32_t value) {
+        cap.entries.push_back(RecordEntry{t, src, static_cast<uint8_t>(type), code, value});
+    };
+    push(REC_KBD, EV_KEY, KEY_F8, 1);
+    push(REC_KBD, EV_KEY, KEY_F8, 0);
+    int held = 0;
+    for (int i = 0; i < reports; ++i) {
+        t += 5000;
+        if (i % 400 == 0) {
+            if (held) push(REC_KBD, EV_KEY, static_cast<uint16_t>(held), 0);
+            held = (i / 400) % 3 == 1 ? KEY_LEFTSHIFT : (i / 400) % 3 == 2 ? KEY_LEFTCTRL : 0;
+            if (held) push(REC_KBD, EV_KEY, static_cast<uint16_t>(held), 1);
+        }
+        double a = i * 0.05;
+        double r = 1.0 + (i % 97) * 0.1;
+        int dx = static_cast<int>(std::lround(r * std::cos(a)));
+        int dy = static_cast<int>(std::lround(r * std::sin(a)));
+        if (dx) push(REC_TP, EV_REL, REL_X, dx);
+        if (dy) push(REC_TP, EV_REL, REL_Y, dy);
+        if (i % 50 == 0) push(REC_TP, EV_REL, REL_WHEEL, (i / 50) % 2 ? 1 : -1);
+        push(REC_TP, EV_SYN, SYN_REPORT, 0);
+    }
+    return cap;
+}
+
+struct RunResult {
+    std::vector<input_event> out;
+    uint64_t reports = 0;
+    MockUinput sink;
+};
+
+struct Pacing {
+    int rate_hz = 0;
+    int decay_ms = 0;
+    int predict_ms = 0;
+};
+
+struct WheelMap {
+    int axis = -1;
+    int units = 0;
+};
+
+struct AxisLock {
+    int64_t lock_q16 = 0;
+    int64_t release_q16 = 0;
+};
+
+// Mirrors the daemon's output path: per report, or with pacing an aligned
+// tick clock driven by the capture's timestamps instead of a timerfd.
+void replay(const Capture& cap, const ModeTable& modes, const ChordTable& chords, const CurveSet& curves,
+            const CurveSet& precise, const MotionFilter& filter, const Pacing& pacing, const WheelMap& wheel,
+            const AxisLock& lock, RunResult& r) {
+    KeyState keys;
+    ChordEngine chord;
+    chord.table = &chords;
+    chord.modes = &modes;
+    chord.resolve(keys);
+    MotionPipeline pipeline;
+    std::vector<DeviceInput> devices(1);
+    pipeline.curves = &curves;
+    pipeline.modes = &modes;
+    pipeline.filter = filter;
+    pipeline.wheel_axis = wheel.axis;
+    pipeline.wheel_units = wheel.units;
+    pipeline.lock_q16 = lock.lock_q16;
+    pipeline.release_q16 = lock.release_q16;
+    FrameBuilder frame;
+    // The sink leaves the finished frame in buf.
+    auto flush = [&]() {
+        int n = r.sink.flush(frame);
+        if (n > 0) r.out.insert(r.out.end(), frame.buf, frame.buf + n);
+    };
+    OutputStage stage;
+    stage.configure(pacing.rate_hz, pacing.decay_ms, pacing.predict_ms);
+    const int64_t tick_us = pacing.rate_hz > 0 ? 1000000 / pacing.rate_hz : 0;
+    int64_t next_tick = 0;  // 0 = disarmed
+    auto zero_all = [&]() {
+        stage.reset();
+        next_tick = 0;
+        for (int axis : ALL_AXES) frame.set_abs(axis, 0);
+        flush();
+    };
+    for (const RecordEntry& e : cap.entries) {
+        input_event ev{};
+        ev.input_event_sec = e.t_us / 1000000;
+        ev.input_event_usec = e.t_us % 1000000;
+        ev.type = e.type;
+        ev.code = e.code;
+        ev.value = e.value;
+        while (next_tick && next_tick <= e.t_us) {
+            bool active = stage.tick(frame);
+            flush();
+            next_tick = active ? next_tick + tick_us : 0;
+        }
+        if (e.source == REC_KBD) {
+            if (ev.type != EV_KEY) continue;
+            keys.set(ev.code, ev.value != 0);
+            if (chord.on_key(ev.code, ev.value, e.t_us, keys)) {
+                bool on = !(keys.load() & KeyState::GRABBED);
+                keys.set_flag(KeyState::GRABBED, on);
+                if (!on) {
+                    for (auto& d : devices) d.reset();
+                    pipeline.reset();
+                    zero_all();
+                }
+            }
+            continue;
+        }
+        if (!(keys.load() & KeyState::GRABBED)) continue;
+        if (ev.type != EV_REL && ev.type != EV_SYN) continue;
+        if (ev.type == EV_SYN && ev.code == SYN_REPORT) ++r.reports;
+        size_t di = e.source == REC_TP ? 0 : e.source - REC_TP_EXTRA + 1;
+        if (di >= devices.size()) devices.resize(di + 1);
+        ReportDelta rd;
+        if (!devices[di].feed(ev, rd)) continue;
+        pipeline.add(rd, e.t_us);
+        MotionFrame mf;
+        pipeline.curves = chord.precise ? &precise : &curves;
+        if (!pipeline.flush(chord.mode, mf)) continue;
+        if (mf.mode_changed) {
+            if (tick_us) stage.reset();
+            else for (int axis : ALL_AXES) frame.set_abs(axis, 0);
+        }
+        const int held = mf.pulse ? mf.n - 1 : mf.n;
+        if (tick_us) {
+            for (int i = 0; i < held; ++i) stage.set(mf.axis[i], mf.value[i]);
+            if (mf.pulse) stage.pulse(mf.axis[held], mf.value[held]);
+            if (!next_tick) next_tick = (e.t_us / tick_us + 1) * tick_us;
+            continue;
+        }
+        for (int i = 0; i < mf.n; ++i) frame.set_abs(mf.axis[i], mf.value[i]);
+        flush();
+        if (mf.pulse) {
+            frame.set_abs(mf.axis[held], 0);
+            flush();
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string capture_path, write_path, expect_path;
+    int synth = 0;
+    int iterations = 20;
+    double gain = DEFAULT_GAIN;
+    std::vector<std::string> curve_args, mode_args, chord_args;
+    std::string filter_arg = "none";
+    std::string wheel_arg = "none";
+    std::string lock_arg = "none";
+    double precision = 0.25;
+    double max_writes = -1, max_events = -1;
+    Pacing pacing;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--synth" && i + 1 < argc) {
+            synth = std::stoi(argv[++i]);
+        } else if (arg == "--gain" && i + 1 < argc) {
+            gain = std::stod(argv[++i]);
+        } else if (arg == "--curve" && i + 1 < argc) {
+            curve_args.push_back(argv[++i]);
+        } else if (arg == "--mode" && i + 1 < argc) {
+            mode_args.push_back(argv[++i]);
+        } else if (arg == "--axis-lock" && i + 1 < argc) {
+            lock_arg = argv[++i];
+        } else if (arg == "--precision" && i + 1 < argc) {
+            precision = std::stod(argv[++i]);
+        } else if (arg == "--chord" && i + 1 < argc) {
+            chord_args.push_back(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter_arg = argv[++i];
+        } else if (arg == "--wheel" && i + 1 < argc) {
+            wheel_arg = argv[++i];
+        } else if (arg == "--rate" && i + 1 < argc) {
+            pacing.rate_hz = std::stoi(argv[++i]);
+        } else if (arg == "--decay-ms" && i + 1 < argc) {
+            pacing.decay_ms = std::stoi(argv[++i]);
+        } else if (arg == "--predict-ms" && i + 1 < argc) {
+            pacing.predict_ms = std::stoi(argv[++i]);
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoi(argv[++i]);
+        } else if (arg == "--write" && i + 1 < argc) {
+            write_path = argv[++i];
+        } else if (arg == "--expect" && i + 1 < argc) {
+            expect_path = argv[++i];
+        } else if (arg == "--max-writes-per-report" && i + 1 < argc) {
+            max_writes = std::stod(argv[++i]);
+        } else if (arg == "--max-events-per-report" && i + 1 < argc) {
+            max_events = std::stod(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-' && capture_path.empty()) {
+            capture_path = arg;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if ((synth > 0) == !capture_path.empty() || iterations < 1) usage(argv[0]);
+    if (pacing.rate_hz < 0 || pacing.rate_hz > 2000 || pacing.decay_ms < 0 || pacing.predict_ms < 0) usage(argv[0]);
+    if (pacing.decay_ms > 0 && pacing.rate_hz == 0) pacing.rate_hz = 250;
+
+    ModeTable modes;
+    CurveSet curves, precise;
+    MotionFilter filter;
+    std::string err;
+    if (!build_modes(mode_args, modes, err)) {
+        std::cerr << "error: --mode: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!build_curves(curve_args, gain, modes, curves, err)) {
+        std::cerr << "error: --curve: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!(precision > 0 && precision <= 1)) usage(argv[0]);
+    if (!build_curves(curve_args, gain * precision, modes, precise, err)) {
+        std::cerr << "error: --precision: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    AxisLock lock;
+    if (!parse_axis_lock_spec(lock_arg, lock.lock_q16, lock.release_q16, err)) {
+        std::cerr << "error: --axis-lock: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!parse_filter_spec(filter_arg, filter, err)) {
+        std::cerr << "error: --filter: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    WheelMap wheel;
+    if (!parse_wheel_spec(wheel_arg, wheel.axis, wheel.units, err)) {
+        std::cerr << "error: --wheel: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Capture cap;
+    if (synth > 0) cap = synth_capture(synth);
+    else if (!load_capture(capture_path, cap)) return EXIT_FAILURE;
+    // The toggle key is the one the capture was recorded with.
+    ChordTable chords;
+    if (!build_chords(chord_args, cap.header.hotkey, modes, chords, err)) {
+        std::cerr << "error: --chord: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    RunResult first;
+    replay(cap, modes, chords, curves, precise, filter, pacing, wheel, lock, first);
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t sink = 0;
+    for (int it = 0; it < iterations; ++it) {
+        RunResult r;
+        r.out.reserve(first.out.size());
+        replay(cap, modes, chords, curves, precise, filter, pacing, wheel, lock, r);
+        sink += r.out.size();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+    double events = static_cast<double>(cap.entries.size()) * iterations;
+    double frames = static_cast<double>(first.reports) * iterations;
+    const double reports = first.reports ? static_cast<double>(first.reports) : 1.0;
+    const double writes_per_report = static_cast<double>(first.sink.writes) / reports;
+    const double events_per_report = static_cast<double>(first.sink.events) / reports;
+
+    std::cout << "{\"events\":" << cap.entries.size()
+              << ",\"reports\":" << first.reports
+              << ",\"frames_out\":" << first.sink.writes
+              << ",\"events_out\":" << first.sink.events
+              << ",\"writes_per_report\":" << writes_per_report
+              << ",\"events_per_report\":" << events_per_report
+              << ",\"iterations\":" << iterations
+              << ",\"events_per_sec\":" << (secs > 0 ? events / secs : 0.0)
+              << ",\"ns_per_report\":" << (frames > 0 ? secs * 1e9 / frames : 0.0)
+              << ",\"checksum\":" << sink << "}" << std::endl;
+
+    const char* bytes = reinterpret_cast<const char*>(first.out.data());
+    const size_t len = first.out.size() * sizeof(input_event);
+    if (!write_path.empty()) {
+        std::ofstream out(write_path, std::ios::binary | std::ios::trunc);
+        out.write(bytes, static_cast<std::streamsize>(len));
+        if (!out) {
+            std::cerr << "failed to write " << write_path << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (!expect_path.empty()) {
+        std::ifstream in(expect_path, std::ios::binary);
+        std::string want((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.eof() && !in) {
+            std::cerr << "cannot read " << expect_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (want.size() != len || std::memcmp(want.data(), bytes, len) != 0) {
+            std::cerr << "output differs from " << expect_path << " (" << len << " vs " << want.size() << " bytes)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "output matches " << expect_path << std::endl;
+    }
+    if (max_writes >= 0 && writes_per_report > max_writes) {
+        std::cerr << "writes per report " << writes_per_report << " exceed the baseline " << max_writes << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (max_events >= 0 && events_per_report > max_events) {
+        std::cerr << "events per report " << events_per_report << " exceed the baseline " << max_events << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "devices.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace tp3d {
+
+namespace {
+
+bool ends_with(const std::string& s, const char* suffix, size_t len) {
+    return s.size() >= len && s.compare(s.size() - len, len, suffix) == 0;
+}
+
+bool matches(const Candidate& c, const std::string& needle) {
+    return contains_ci(c.base, needle) || (!c.name.empty() && contains_ci(c.name, needle));
+}
+
+}  // namespace
+
+bool contains_ci(const std::string& hay, const std::string& needle) {
+    auto eq = [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    };
+    return std::search(hay.begin(), hay.end(), needle.begin(), needle.end(), eq) != hay.end();
+}
+
+bool is_capable(const Candidate& c, bool want_mouse) {
+    return want_mouse ? ends_with(c.base, "-event-mouse", 12) && c.has_rel_xy : ends_with(c.base, "-event-kbd", 10) && c.has_keys;
+}
+
+int match_rules(const Candidate& c, const std::vector<std::string>& rules) {
+    for (size_t i = 0; i < rules.size(); ++i) {
+        if (!rules[i].empty() && matches(c, rules[i])) return static_cast<int>(i) + 1;
+    }
+    return 0;
+}
+
+std::string first_capable(const std::vector<Candidate>& pool, bool want_mouse) {
+    for (const auto& c : pool) {
+        if (is_capable(c, want_mouse)) return c.path;
+    }
+    return {};
+}
+
+std::string choose_candidate(const std::vector<Candidate>& pool, bool want_mouse, const std::vector<std::string>& rules,
+                             bool keywords, std::string& reason) {
+    static const std::vector<std::string> tp_kws = {"trackpoint", "thinkpad", "lenovo", "trackpad", "touchpad", "logitech", "mouse"};
+    static const std::vector<std::string> kb_kws = {"keyboard", "kbd", "thinkpad", "lenovo", "logitech"};
+    int rix = 0;
+    for (const auto& r : rules) {
+        ++rix;
+        if (r.empty()) continue;
+        for (const auto& c : pool) {
+            if (!is_capable(c, want_mouse) || !matches(c, r)) continue;
+            reason = "rule " + std::to_string(rix) + " ('" + r + "')";
+            return c.path;
+        }
+    }
+    if (!keywords) return {};
+    for (const auto& kw : want_mouse ? tp_kws : kb_kws) {
+        for (const auto& c : pool) {
+            if (!is_capable(c, want_mouse) || !matches(c, kw)) continue;
+            reason = "keyword '" + kw + "'";
+            return c.path;
+        }
+    }
+    std::string path = first_capable(pool, want_mouse);
+    if (!path.empty()) reason = "first capable in order";
+    return path;
+}
+
+}  // namespace tp3d
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Device selection: matching /dev/input/by-id and by-path links against
+// --tp-match/--kbd-match rules. Plain string work, no device access; the
+// daemon fills the capabilities from its probe cache.
+namespace tp3d {
+
+struct Candidate {
+    std::string path;
+    std::string base;    // link name, e.g. usb-...-event-mouse
+    std::string origin;  // by-id or by-path
+    std::string name;    // evdev name, empty if unknown
+    bool has_rel_xy = false;
+    bool has_keys = false;
+};
+
+// Case-insensitive substring test without building lowercased copies.
+bool contains_ci(const std::string& hay, const std::string& needle);
+
+// An -event-mouse link with REL_X/Y (want_mouse) or an -event-kbd link
+// with keys.
+bool is_capable(const Candidate& c, bool want_mouse);
+// 1-based index of the first non-empty rule found in the link name or the
+// evdev name, 0 if none matches. Does not check the kind.
+int match_rules(const Candidate& c, const std::vector<std::string>& rules);
+// Path of the first capable candidate of the kind, "" if none.
+std::string first_capable(const std::vector<Candidate>& pool, bool want_mouse);
+
+// Picks from pool the first capable candidate that matches a rule, trying
+// the rules in order. With keywords, falls back to built-in name
+// keywords and then to the first candidate of that kind. Returns the path
+// and sets reason, or returns "".
+std::string choose_candidate(const std::vector<Candidate>& pool, bool want_mouse, const std::vector<std::string>& rules,
+                             bool keywords, std::string& reason);
+
+}  // namespace tp3d
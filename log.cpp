@@ -0,0 +1,234 @@
+#include "log.hpp"
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+namespace tp3d {
+
+namespace {
+
+constexpr size_t LOG_LINE_BYTES = 512;
+constexpr size_t LOG_SLOTS = 256;
+
+// Bounded multi-producer ring (per-slot sequence numbers), one consumer. A
+// slot is claimed, formatted in place and published by bumping its sequence.
+struct Slot {
+    std::atomic<size_t> seq{0};
+    LogLevel level = LogLevel::INFO;
+    size_t len = 0;
+    char text[LOG_LINE_BYTES];
+};
+
+struct Logger {
+    Slot slots[LOG_SLOTS];
+    std::atomic<size_t> head{0};
+    size_t tail = 0;  // consumer only
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<int> max_level{static_cast<int>(LogLevel::INFO)};
+    std::atomic<bool> async{false};
+    std::atomic<int> producers{0};  // enqueue() calls between the async check and publish
+    std::atomic<bool> stopping{false};
+    int wake_fd = -1;
+    bool journal = false;
+    std::thread writer;
+
+    Logger() {
+        for (size_t i = 0; i < LOG_SLOTS; ++i) slots[i].seq.store(i, std::memory_order_relaxed);
+        const char* js = std::getenv("JOURNAL_STREAM");
+        journal = js && *js;
+    }
+    ~Logger() { log_stop(); }
+
+    Slot* claim() {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& s = slots[pos % LOG_SLOTS];
+            const size_t seq = s.seq.load(std::memory_order_acquire);
+            const auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return &s;
+            } else if (dif < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    void publish(Slot& s) {
+        // seq still holds the claimed position; one past it marks it full.
+        s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        const uint64_t one = 1;
+        // Never blocks: the fd is non-blocking and only overflows after 2^64-2 wakeups.
+        ssize_t r = write(wake_fd, &one, sizeof(one));
+        (void)r;
+    }
+    // Writes every published slot; returns false once the ring is empty.
+    bool drain_one() {
+        Slot& s = slots[tail % LOG_SLOTS];
+        if (s.seq.load(std::memory_order_acquire) != tail + 1) return false;
+        emit(s.level, s.text, s.len);
+        s.seq.store(tail + LOG_SLOTS, std::memory_order_release);
+        ++tail;
+        return true;
+    }
+    void drain() {
+        while (drain_one()) {}
+        if (uint64_t n = dropped.exchange(0, std::memory_order_relaxed)) {
+            char buf[64];
+            int len = std::snprintf(buf, sizeof(buf), "[log] %llu messages dropped", static_cast<unsigned long long>(n));
+            emit(LogLevel::WARN, buf, static_cast<size_t>(len));
+        }
+    }
+    void emit(LogLevel level, const char* text, size_t len) {
+        static const char* const prefix[] = {"<3>", "<4>", "<6>", "<7>"};
+        char line[LOG_LINE_BYTES + 8];
+        size_t n = 0;
+        if (journal) {
+            std::memcpy(line, prefix[static_cast<int>(level)], 3);
+            n = 3;
+        }
+        std::memcpy(line + n, text, len);
+        n += len;
+        line[n++] = '\n';
+        const int fd = level <= LogLevel::WARN ? STDERR_FILENO : STDOUT_FILENO;
+        for (size_t off = 0; off < n;) {
+            ssize_t w = write(fd, line + off, n - off);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return;
+            off += static_cast<size_t>(w);
+        }
+    }
+    void run() {
+        // Niced, never starved: log lines still come out under full load,
+        // just never ahead of the event loop. Nice means nothing under an RT
+        // policy, which the thread inherits when the unit starts the whole
+        // process with CPUSchedulingPolicy=, so it drops back to SCHED_OTHER.
+        sched_param sp{};
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+        pollfd p{wake_fd, POLLIN, 0};
+        while (!stopping.load(std::memory_order_acquire)) {
+            drain();
+            if (poll(&p, 1, -1) > 0) {
+                uint64_t v;
+                ssize_t r = read(wake_fd, &v, sizeof(v));
+                (void)r;
+            }
+        }
+        drain();
+    }
+};
+
+Logger& logger() {
+    static Logger l;
+    return l;
+}
+
+void enqueue(LogLevel level, const char* fmt, va_list ap) {
+    Logger& l = logger();
+    l.producers.fetch_add(1);
+    if (!l.async.load()) {
+        l.producers.fetch_sub(1);
+        char buf[LOG_LINE_BYTES];
+        int len = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+        if (len < 0) return;
+        l.emit(level, buf, std::min(static_cast<size_t>(len), sizeof(buf) - 1));
+        return;
+    }
+    if (Slot* s = l.claim()) {
+        int len = std::vsnprintf(s->text, sizeof(s->text), fmt, ap);
+        s->level = level;
+        s->len = len < 0 ? 0 : std::min(static_cast<size_t>(len), sizeof(s->text) - 1);
+        l.publish(*s);
+    }
+    l.producers.fetch_sub(1, std::memory_order_release);
+}
+
+void enqueue_f(LogLevel level, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    enqueue(level, fmt, ap);
+    va_end(ap);
+}
+
+}  // namespace
+
+bool parse_log_level(const std::string& s, LogLevel& out) {
+    static const std::pair<const char*, LogLevel> names[] = {
+        {"error", LogLevel::ERROR}, {"warn", LogLevel::WARN}, {"info", LogLevel::INFO}, {"debug", LogLevel::DEBUG}};
+    for (const auto& n : names) {
+        if (s == n.first) {
+            out = n.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+void set_log_level(LogLevel level) {
+    logger().max_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void log_start() {
+    Logger& l = logger();
+    if (l.async.load()) return;
+    l.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (l.wake_fd < 0) {
+        perror("eventfd (log)");
+        return;
+    }
+    // Whatever iostreams still buffer must come out before the writer's lines.
+    std::cout.flush();
+    std::cerr.flush();
+    l.stopping.store(false);
+    l.writer = std::thread([&l] { l.run(); });
+    l.async.store(true, std::memory_order_release);
+}
+
+void log_stop() {
+    Logger& l = logger();
+    if (!l.async.exchange(false)) return;
+    // A producer that saw async still set writes into the ring and signals
+    // wake_fd; wait for it so the writer's last drain has its line and the
+    // fd is not closed under it.
+    while (l.producers.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    l.stopping.store(true, std::memory_order_release);
+    const uint64_t one = 1;
+    ssize_t r = write(l.wake_fd, &one, sizeof(one));
+    (void)r;
+    l.writer.join();
+    close(l.wake_fd);
+    l.wake_fd = -1;
+}
+
+void log_msg(LogLevel level, const char* fmt, ...) {
+    if (static_cast<int>(level) > logger().max_level.load(std::memory_order_relaxed)) return;
+    va_list ap;
+    va_start(ap, fmt);
+    enqueue(level, fmt, ap);
+    va_end(ap);
+}
+
+void log_text(LogLevel level, const std::string& text) {
+    enqueue_f(level, "%s", text.c_str());
+}
+
+}  // namespace tp3d
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Logging that never blocks the event loop: messages go into a fixed ring of
+// preformatted lines and a low-priority thread writes them out. A full ring
+// drops the message and counts it rather than waiting for stdout.
+namespace tp3d {
+
+enum class LogLevel { ERROR, WARN, INFO, DEBUG };
+
+bool parse_log_level(const std::string& s, LogLevel& out);
+// Messages above this level are discarded when logged (default INFO).
+void set_log_level(LogLevel level);
+
+// Starts the writer thread; until then, and after log_stop(), lines are
+// written synchronously. log_stop() writes out everything still queued.
+void log_start();
+void log_stop();
+
+// printf-style; one line, newline added, truncated at 511 bytes. Errors and
+// warnings go to stderr, the rest to stdout. Under journald each line
+// carries its syslog priority.
+void log_msg(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+// Queues text as-is, whatever the level setting (--stats output).
+void log_text(LogLevel level, const std::string& text);
+
+}  // namespace tp3d
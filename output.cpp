@@ -0,0 +1,227 @@
+#include "output.hpp"
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "log.hpp"
+
+namespace tp3d {
+
+UinputOutput::~UinputOutput() {
+    if (fd < 0) return;
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+}
+
+KeyPassthrough::~KeyPassthrough() {
+    if (fd < 0) return;
+    release_all();
+    flush();
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+}
+
+void KeyPassthrough::key(const input_event& ev, bool swallow) {
+    if (ev.code > KEY_MAX) return;
+    uint64_t& word = sent[ev.code >> 6];
+    const uint64_t bit = uint64_t{1} << (ev.code & 63);
+    if (ev.value == 1) {
+        if (swallow) return;
+        word |= bit;
+    } else if (!(word & bit)) {
+        // Release or repeat of a key whose press was ours.
+        return;
+    } else if (ev.value == 0) {
+        word &= ~bit;
+    }
+    // Leave room for the closing SYN_REPORT.
+    if (n + 2 > static_cast<int>(sizeof(buf) / sizeof(buf[0]))) {
+        sync();
+        flush();
+    }
+    if (n == 0) first_us = event_time_us(ev);
+    buf[n] = input_event{};
+    buf[n].type = EV_KEY;
+    buf[n].code = ev.code;
+    buf[n].value = ev.value;
+    ++n;
+    ++since_syn;
+}
+
+void KeyPassthrough::sync() {
+    if (since_syn == 0) return;
+    buf[n] = input_event{};
+    buf[n].type = EV_SYN;
+    buf[n].code = SYN_REPORT;
+    ++n;
+    since_syn = 0;
+}
+
+void KeyPassthrough::release_all() {
+    for (int w = 0; w < static_cast<int>(sizeof(sent) / sizeof(sent[0])); ++w) {
+        while (sent[w]) {
+            input_event ev{};
+            ev.type = EV_KEY;
+            ev.code = static_cast<uint16_t>(w * 64 + __builtin_ctzll(sent[w]));
+            ev.value = 0;
+            key(ev, false);
+        }
+    }
+    sync();
+}
+
+int KeyPassthrough::flush() {
+    sync();
+    if (n == 0) return 0;
+    const ssize_t len = static_cast<ssize_t>(n * sizeof(input_event));
+    const int count = n;
+    n = 0;
+    Stats::bump(g_stats.syscalls);
+    if (write(fd, buf, len) != len) {
+        perror("write passthrough");
+        return -1;
+    }
+    return count;
+}
+
+namespace {
+constexpr int32_t UEV_MOTION = 0;
+}
+
+bool SpnavOutput::open(const std::string& socket_path) {
+    path = socket_path;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "spnav socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // A stale socket from a crashed server is replaced; a live one is not.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        close(probe);
+        if (live) {
+            std::cerr << "spnav socket " << path << " is in use (is spacenavd running?)" << std::endl;
+            return false;
+        }
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        perror("bind/listen spnav socket");
+        close(fd);
+        return false;
+    }
+    // Clients run as the desktop user, like with spacenavd.
+    chmod(path.c_str(), 0666);
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll (spnav)");
+        if (ep >= 0) close(ep);
+        ep = -1;
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    listen_fd = fd;
+    std::cout << "[spnav] listening on " << path << std::endl;
+    return true;
+}
+
+SpnavOutput::~SpnavOutput() {
+    for (int c : clients) close(c);
+    if (ep >= 0) close(ep);
+    if (listen_fd < 0) return;
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+void SpnavOutput::drop(size_t i) {
+    close(clients[i]);
+    clients.erase(clients.begin() + static_cast<long>(i));
+    log_msg(LogLevel::INFO, "[spnav] client disconnected (%zu)", clients.size());
+}
+
+void SpnavOutput::on_readable() {
+    epoll_event evs[16];
+    int n = epoll_wait(ep, evs, 16, 0);
+    for (int k = 0; k < n; ++k) {
+        const int fd = evs[k].data.fd;
+        if (fd == listen_fd) {
+            int c;
+            while ((c = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.fd = c;
+                if (epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev) < 0) {
+                    perror("epoll_ctl (spnav client)");
+                    close(c);
+                    continue;
+                }
+                clients.push_back(c);
+                log_msg(LogLevel::INFO, "[spnav] client connected (%zu)", clients.size());
+            }
+            continue;
+        }
+        auto it = std::find(clients.begin(), clients.end(), fd);
+        if (it == clients.end()) continue;
+        // The protocol has nothing for the server to act on; whatever a
+        // client sends is read away so it cannot fill the socket buffer.
+        bool gone = evs[k].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+        char buf[256];
+        while (!gone) {
+            ssize_t r = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && errno == EAGAIN) break;
+            gone = r <= 0;
+        }
+        if (gone) drop(static_cast<size_t>(it - clients.begin()));
+    }
+}
+
+int SpnavOutput::flush(FrameBuilder& fb) {
+    int count = fb.finish();
+    if (count == 0) return 0;
+    const int64_t now = monotonic_ns();
+    int32_t pkt[8] = {UEV_MOTION,
+                      fb.last_abs[ABS_X], fb.last_abs[ABS_Y], fb.last_abs[ABS_Z],
+                      fb.last_abs[ABS_RX], fb.last_abs[ABS_RY], fb.last_abs[ABS_RZ],
+                      last_ns ? static_cast<int32_t>((now - last_ns) / 1000000) : 0};
+    last_ns = now;
+    // A client that cannot keep up misses this packet; one that is gone, or
+    // got a torn packet, is dropped.
+    for (size_t i = 0; i < clients.size();) {
+        Stats::bump(g_stats.syscalls);
+        ssize_t r = send(clients[i], pkt, sizeof(pkt), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (r != static_cast<ssize_t>(sizeof(pkt)) && !(r < 0 && errno == EAGAIN)) {
+            drop(i);
+            continue;
+        }
+        ++i;
+    }
+    Stats::bump(g_stats.frames_out);
+    return count;
+}
+
+}  // namespace tp3d
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+
+// Output backends: where finished frames go. The daemon picks one at startup
+// and every flush goes through it.
+namespace tp3d {
+
+struct Output {
+    virtual ~Output() = default;
+    // Publishes the frame's pending axes. Returns the number of events sent
+    // (0 when nothing changed), -1 on error.
+    virtual int flush(FrameBuilder& fb) = 0;
+    // An fd the event loop watches for the backend (-1 for none) and the
+    // handler it calls when that fd is readable.
+    virtual int poll_fd() const { return -1; }
+    virtual void on_readable() {}
+};
+
+// The virtual 6DOF device; fd comes from setup_uinput() and is destroyed with
+// the backend.
+struct UinputOutput : Output {
+    int fd = -1;
+
+    explicit UinputOutput(int ufd) : fd(ufd) {}
+    ~UinputOutput() override;
+    int flush(FrameBuilder& fb) override { return fb.flush(fd); }
+};
+
+// --kbd-grab: the keys of the grabbed keyboard that are not ours, re-injected
+// through a virtual keyboard (fd from setup_uinput_keyboard(), destroyed with
+// this). Events queue per wakeup with their SYN_REPORT boundaries and go out
+// in one write. A release follows its press, so a key that was down when
+// capture started is still released in the focused app.
+struct KeyPassthrough {
+    int fd = -1;
+    uint64_t sent[(KEY_MAX + 64) / 64] = {};  // keys whose press went out
+    input_event buf[64];
+    int n = 0;
+    int since_syn = 0;
+    int64_t first_us = 0;  // kernel timestamp of the oldest queued event
+
+    explicit KeyPassthrough(int ufd) : fd(ufd) {}
+    ~KeyPassthrough();
+    // A key event of the real keyboard; swallow decides for presses only.
+    void key(const input_event& ev, bool swallow);
+    // The real keyboard's SYN_REPORT: closes the queued report, if any.
+    void sync();
+    // Queues releases for every key still down on the virtual keyboard.
+    void release_all();
+    // Writes the queue; returns the events written, 0 if none, -1 on error.
+    int flush();
+    bool pending() const { return n > 0; }
+};
+
+// Serves libspnav clients directly on an AF_UNIX socket with the original
+// spacenavd protocol: each motion frame is one packet of eight ints
+// (UEV_MOTION, x, y, z, rx, ry, rz, period in ms). Replaces spacenavd, so
+// it must not be running on the same socket.
+constexpr const char* DEFAULT_SPNAV_SOCKET = "/var/run/spnav.sock";
+
+struct SpnavOutput : Output {
+    std::string path;
+    int listen_fd = -1;
+    int ep = -1;  // the listening socket and every client, for on_readable()
+    std::vector<int> clients;
+    int64_t last_ns = 0;
+
+    // Binds and listens on path; false (with errno reported) if it fails or
+    // another server already answers there.
+    bool open(const std::string& socket_path);
+    ~SpnavOutput() override;
+    int flush(FrameBuilder& fb) override;
+    int poll_fd() const override { return ep; }
+    // Accepts pending clients, discards what they send and drops the ones
+    // that hung up, so an idle puck does not keep dead sockets around.
+    void on_readable() override;
+
+  private:
+    void drop(size_t i);
+};
+
+}  // namespace tp3d
@@ -0,0 +1,555 @@
+#include "pipeline.hpp"
+
+#include <cstring>
+
+namespace tp3d {
+
+Stats g_stats;
+
+bool parse_double_strict(const std::string& s, double& out) {
+    if (s.empty()) return false;
+    try {
+        size_t pos = 0;
+        out = std::stod(s, &pos);
+        return pos == s.size() && std::isfinite(out);
+    } catch (...) {
+        return false;
+    }
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::string cur;
+    std::istringstream in(s);
+    while (std::getline(in, cur, sep)) out.push_back(cur);
+    return out;
+}
+
+bool parse_curve_spec(const std::string& s, CurveSpec& c, std::string& err) {
+    auto parts = split(s, ':');
+    if (parts.empty()) { err = "empty curve"; return false; }
+    const std::string& kind = parts[0];
+    c = CurveSpec{};
+    if (kind == "linear" && parts.size() == 1) {
+        c.kind = CurveKind::LINEAR;
+    } else if (kind == "power" && parts.size() == 2) {
+        c.kind = CurveKind::POWER;
+        if (!parse_double_strict(parts[1], c.p1) || c.p1 <= 0) { err = "power exponent must be > 0"; return false; }
+    } else if (kind == "sigmoid" && (parts.size() == 2 || parts.size() == 3)) {
+        c.kind = CurveKind::SIGMOID;
+        if (!parse_double_strict(parts[1], c.p1) || c.p1 <= 0) { err = "sigmoid midpoint must be > 0"; return false; }
+        c.p2 = 1.0;
+        if (parts.size() == 3 && (!parse_double_strict(parts[2], c.p2) || c.p2 <= 0)) { err = "sigmoid steepness must be > 0"; return false; }
+    } else if (kind == "table" && s.size() > 6) {
+        c.kind = CurveKind::TABLE;
+        for (const auto& pt : split(s.substr(6), ',')) {
+            auto xy = split(pt, ':');
+            double x = 0, y = 0;
+            if (xy.size() != 2 || !parse_double_strict(xy[0], x) || !parse_double_strict(xy[1], y) || x < 0) {
+                err = "bad table point '" + pt + "' (want <in>:<out>)";
+                return false;
+            }
+            if (!c.points.empty() && x <= c.points.back().first) { err = "table inputs must be increasing"; return false; }
+            c.points.emplace_back(x, y);
+        }
+        if (c.points.empty()) { err = "table needs at least one point"; return false; }
+    } else {
+        err = "unknown curve '" + s + "'";
+        return false;
+    }
+    return true;
+}
+
+static double curve_shape(const CurveSpec& c, double x) {
+    switch (c.kind) {
+        case CurveKind::POWER:
+            return std::pow(x, c.p1);
+        case CurveKind::SIGMOID: {
+            // Logistic S-curve through the origin, saturating at 2*mid counts.
+            auto sig = [&](double v){ return 1.0 / (1.0 + std::exp(-c.p2 * (v - c.p1))); };
+            double s0 = sig(0.0);
+            return 2.0 * c.p1 * (sig(x) - s0) / (1.0 - s0);
+        }
+        case CurveKind::TABLE: {
+            // Piecewise linear, implicit (0,0) origin, flat past the last point.
+            double px = 0.0, py = 0.0;
+            for (const auto& pt : c.points) {
+                if (x <= pt.first) {
+                    if (pt.first == px) return pt.second;
+                    return py + (pt.second - py) * (x - px) / (pt.first - px);
+                }
+                px = pt.first;
+                py = pt.second;
+            }
+            return py;
+        }
+        default:
+            return x;
+    }
+}
+
+CurveLut compile_curve(const CurveSpec& c, double gain) {
+    CurveLut lut;
+    for (int i = 0; i < CURVE_LUT_SIZE; ++i) {
+        double v = std::round(gain * curve_shape(c, static_cast<double>(i)));
+        lut.y[i] = static_cast<int32_t>(std::max(-1e9, std::min(1e9, v)));
+    }
+    lut.tail_slope = c.kind == CurveKind::TABLE ? 0 : lut.y[CURVE_LUT_SIZE - 1] - lut.y[CURVE_LUT_SIZE - 2];
+    return lut;
+}
+
+bool build_curves(const std::vector<std::string>& entries, double gain, const ModeTable& modes,
+                  CurveSet& out, std::string& err) {
+    CurveSpec specs[MAX_MODES][2];
+    for (const auto& list : entries) {
+        for (const auto& entry : split(list, ';')) {
+            if (entry.empty()) continue;
+            std::string sel, spec = entry;
+            auto eq = entry.find('=');
+            if (eq != std::string::npos) {
+                sel = entry.substr(0, eq);
+                spec = entry.substr(eq + 1);
+            }
+            std::string mode_sel = sel, axis_sel;
+            auto dot = sel.find('.');
+            if (dot != std::string::npos) {
+                mode_sel = sel.substr(0, dot);
+                axis_sel = sel.substr(dot + 1);
+            } else if (sel == "x" || sel == "y") {
+                mode_sel.clear();
+                axis_sel = sel;
+            }
+            int m_lo = 0, m_hi = MAX_MODES - 1, a_lo = 0, a_hi = 1;
+            if (!mode_sel.empty()) {
+                int m = modes.find(mode_sel);
+                if (m < 0) { err = "unknown curve mode '" + mode_sel + "'"; return false; }
+                m_lo = m_hi = m;
+            }
+            if (!axis_sel.empty()) {
+                if (axis_sel != "x" && axis_sel != "y") { err = "unknown curve axis '" + axis_sel + "'"; return false; }
+                a_lo = a_hi = (axis_sel == "y");
+            }
+            CurveSpec c;
+            if (!parse_curve_spec(spec, c, err)) return false;
+            for (int m = m_lo; m <= m_hi; ++m)
+                for (int a = a_lo; a <= a_hi; ++a) specs[m][a] = c;
+        }
+    }
+    for (int m = 0; m < MAX_MODES; ++m)
+        for (int a = 0; a < 2; ++a) out.lut[m][a] = compile_curve(specs[m][a], gain);
+    return true;
+}
+
+bool build_modes(const std::vector<std::string>& entries, ModeTable& out, std::string& err) {
+    static const std::pair<const char*, uint16_t> axes[] = {
+        {"x", ABS_X}, {"y", ABS_Y}, {"z", ABS_Z}, {"rx", ABS_RX}, {"ry", ABS_RY}, {"rz", ABS_RZ}};
+    out = DEFAULT_MODES;
+    for (const auto& list : entries) {
+        for (const auto& entry : split(list, ';')) {
+            if (entry.empty()) continue;
+            auto colon = entry.find(':');
+            std::string head = entry.substr(0, colon);
+            std::string map = colon == std::string::npos ? "" : entry.substr(colon + 1);
+            auto at = head.find('@');
+            std::string name = head.substr(0, at);
+            if (name.empty() || name.size() > 15 || name.find('.') != std::string::npos || name == "x" || name == "y") {
+                err = "bad mode name '" + name + "'";
+                return false;
+            }
+            int m = out.find(name);
+            if (m < 0) {
+                if (map.empty()) { err = "new mode '" + name + "' needs a map"; return false; }
+                if (out.count == MAX_MODES) { err = "too many modes"; return false; }
+                m = out.count++;
+                out.def[m] = ModeDef{};
+                std::memcpy(out.def[m].name, name.c_str(), name.size());
+            }
+            if (!map.empty()) {
+                ModeDef& d = out.def[m];
+                d.n = 0;
+                for (const auto& item : split(map, ',')) {
+                    auto eq = item.find('=');
+                    std::string in = item.substr(0, eq);
+                    std::string target = eq == std::string::npos ? "" : item.substr(eq + 1);
+                    int8_t sign = 1;
+                    if (!target.empty() && target[0] == '-') { sign = -1; target.erase(0, 1); }
+                    auto ax = std::find_if(std::begin(axes), std::end(axes), [&](const auto& a){ return target == a.first; });
+                    if ((in != "x" && in != "y") || ax == std::end(axes) || d.n == MODE_OUTPUTS) {
+                        err = "bad mapping '" + item + "' in mode '" + name + "' (want <x|y>=[-]<axis>, at most 4)";
+                        return false;
+                    }
+                    d.src[d.n] = in == "y";
+                    d.sign[d.n] = sign;
+                    d.axis[d.n] = ax->second;
+                    ++d.n;
+                }
+            }
+            if (at != std::string::npos) {
+                uint32_t mods = 0;
+                const std::string ms = head.substr(at + 1);
+                if (ms != "none") {
+                    for (const auto& k : split(ms, '+')) {
+                        if (k == "shift") mods |= KeyState::SHIFT;
+                        else if (k == "ctrl") mods |= KeyState::CTRL;
+                        else if (k == "alt") mods |= KeyState::ALT;
+                        else { err = "unknown modifier '" + k + "' (want shift, ctrl, alt or none)"; return false; }
+                    }
+                }
+                out.by_mods[mods] = static_cast<uint8_t>(m);
+            }
+        }
+    }
+    return true;
+}
+
+bool build_chords(const std::vector<std::string>& entries, int hotkey, const ModeTable& modes, ChordTable& out,
+                  std::string& err) {
+    out = ChordTable{};
+    if (hotkey >= 0 && hotkey <= KEY_MAX) out.key[hotkey].action = CHORD_TOGGLE;
+    for (const auto& list : entries) {
+        for (const auto& entry : split(list, ';')) {
+            if (entry.empty()) continue;
+            auto eq = entry.find('=');
+            const std::string lhs = entry.substr(0, eq);
+            const std::string rhs = eq == std::string::npos ? "" : entry.substr(eq + 1);
+            double v;
+            if (lhs == "double-ms") {
+                if (!parse_double_strict(rhs, v) || v < 50 || v > 2000) { err = "double-ms must be between 50 and 2000"; return false; }
+                out.double_us = static_cast<int64_t>(v * 1000);
+                continue;
+            }
+            if (!parse_double_strict(lhs, v) || v < 1 || v > KEY_MAX || v != static_cast<int>(v)) {
+                err = "bad key code '" + lhs + "' in '" + entry + "'";
+                return false;
+            }
+            const int code = static_cast<int>(v);
+            auto colon = rhs.find(':');
+            const std::string what = rhs.substr(0, colon);
+            ChordBinding b;
+            if (what == "toggle" && colon == std::string::npos) {
+                b.action = CHORD_TOGGLE;
+            } else if (what == "precision" && colon == std::string::npos) {
+                b.action = CHORD_PRECISION;
+            } else {
+                if (what == "hold") b.action = CHORD_HOLD;
+                else if (what == "latch") b.action = CHORD_LATCH;
+                else if (what == "double") b.action = CHORD_DOUBLE;
+                else { err = "bad action in '" + entry + "' (want toggle, precision, hold:<mode>, latch:<mode> or double:<mode>)"; return false; }
+                const int m = colon == std::string::npos ? -1 : modes.find(rhs.substr(colon + 1));
+                if (m < 0) { err = "unknown mode in '" + entry + "'"; return false; }
+                b.mode = static_cast<uint8_t>(m);
+            }
+            const auto held = [](uint8_t a) { return a == CHORD_HOLD || a == CHORD_PRECISION; };
+            if (held(b.action) && !held(out.key[code].action)) {
+                if (out.n_hold == MAX_HOLD_KEYS) { err = "too many hold keys"; return false; }
+                out.hold[out.n_hold++] = static_cast<uint16_t>(code);
+            }
+            out.key[code] = b;
+        }
+    }
+    return true;
+}
+
+bool ChordEngine::on_key(int code, int value, int64_t t_us, const KeyState& keys) {
+    if (code < 0 || code > KEY_MAX || value == 2) return false;
+    const ChordBinding b = table ? table->key[code] : ChordBinding{};
+    bool toggled = false;
+    if (value == 1) {
+        switch (b.action) {
+            case CHORD_TOGGLE:
+                toggled = true;
+                break;
+            case CHORD_HOLD:
+                hold_key = code;
+                break;
+            case CHORD_LATCH:
+                latched = latched == b.mode ? -1 : b.mode;
+                break;
+            case CHORD_DOUBLE:
+                if (tap_key == code && t_us - tap_us <= table->double_us) {
+                    latched = latched == b.mode ? -1 : b.mode;
+                    tap_key = -1;
+                    break;
+                }
+                tap_key = code;
+                tap_us = t_us;
+                break;
+            default:
+                break;
+        }
+        // Any other key in between makes it two single taps.
+        if (b.action != CHORD_DOUBLE) tap_key = -1;
+    }
+    resolve(keys);
+    return toggled;
+}
+
+void ChordEngine::resolve(const KeyState& keys) {
+    // Also picks up a hold key that went down while events were lost.
+    const bool hold_down = hold_key >= 0 && keys.is_down(hold_key);
+    if (!hold_down) hold_key = -1;
+    precise = false;
+    for (int i = 0; table && i < table->n_hold; ++i) {
+        const int code = table->hold[i];
+        if (!keys.is_down(code)) continue;
+        if (table->key[code].action == CHORD_PRECISION) precise = true;
+        else if (!hold_down) hold_key = code;
+    }
+    if (hold_key >= 0) mode = table->key[hold_key].mode;
+    else if (latched >= 0) mode = static_cast<uint8_t>(latched);
+    else mode = modes->by_mods[keys.load() & KeyState::MOD_MASK];
+}
+
+bool parse_axis_lock_spec(const std::string& s, int64_t& lock_q16, int64_t& release_q16, std::string& err) {
+    lock_q16 = release_q16 = 0;
+    if (s.empty() || s == "none") return true;
+    auto parts = split(s, ':');
+    double lock, release;
+    if (parts.size() > 2 || !parse_double_strict(parts[0], lock) || lock <= 0 || lock >= 1) {
+        err = "ratio must be between 0 and 1 (exclusive)";
+        return false;
+    }
+    release = std::min(1.0, 2 * lock);
+    if (parts.size() == 2 && (!parse_double_strict(parts[1], release) || release < lock || release > 1)) {
+        err = "release must be between the ratio and 1";
+        return false;
+    }
+    lock_q16 = std::llround(lock * Q16_ONE);
+    release_q16 = std::llround(release * Q16_ONE);
+    return true;
+}
+
+bool parse_filter_spec(const std::string& s, MotionFilter& f, std::string& err) {
+    auto parts = split(s, ':');
+    f = MotionFilter{};
+    if (parts.empty() || (parts[0] == "none" && parts.size() == 1)) return true;
+    if (parts[0] == "ema" && parts.size() == 2) {
+        f.kind = FilterKind::EMA;
+        if (!parse_double_strict(parts[1], f.alpha) || f.alpha <= 0 || f.alpha > 1) { err = "ema alpha must be in (0, 1]"; return false; }
+        return true;
+    }
+    if (parts[0] == "oneeuro" && parts.size() >= 2 && parts.size() <= 4) {
+        f.kind = FilterKind::ONE_EURO;
+        if (!parse_double_strict(parts[1], f.min_cutoff) || f.min_cutoff <= 0) { err = "oneeuro min_cutoff must be > 0"; return false; }
+        if (parts.size() >= 3 && (!parse_double_strict(parts[2], f.beta) || f.beta < 0)) { err = "oneeuro beta must be >= 0"; return false; }
+        if (parts.size() == 4 && (!parse_double_strict(parts[3], f.d_cutoff) || f.d_cutoff <= 0)) { err = "oneeuro d_cutoff must be > 0"; return false; }
+        return true;
+    }
+    err = "unknown filter '" + s + "'";
+    return false;
+}
+
+bool parse_device_map(const std::string& s, DeviceMap& m, std::string& err) {
+    m = DeviceMap{};
+    if (s.empty()) return true;
+    for (const auto& opt : split(s, ',')) {
+        double g = 0;
+        if (opt == "swap") m.swap_xy = true;
+        else if (opt == "invert-x") m.invert_x = true;
+        else if (opt == "invert-y") m.invert_y = true;
+        else if (opt.rfind("gain=", 0) == 0 && parse_double_strict(opt.substr(5), g) && g > 0 && g <= 64)
+            m.gain_q8 = static_cast<int32_t>(std::lround(g * 256));
+        else {
+            err = "bad device option '" + opt + "' (want gain=<0..64>, swap, invert-x, invert-y)";
+            return false;
+        }
+    }
+    return true;
+}
+
+static int percentile(std::vector<int>& v, double q) {
+    if (v.empty()) return 0;
+    auto it = v.begin() + static_cast<long>(static_cast<double>(v.size() - 1) * q);
+    std::nth_element(v.begin(), it, v.end());
+    return *it;
+}
+
+bool compute_calibration(std::vector<int> rest, std::vector<int> push, int axis_max, Calibration& out,
+                         std::string& err) {
+    out = Calibration{};
+    if (push.size() < 50) {
+        err = "only " + std::to_string(push.size()) + " reports while pushing; push longer and harder";
+        return false;
+    }
+    out.noise = percentile(rest, 0.99);
+    out.full = percentile(push, 0.99);
+    out.deadzone = out.noise + 1;
+    if (out.full < 4 * out.deadzone) {
+        err = "full force (" + std::to_string(out.full) + ") is too close to the rest noise (" +
+              std::to_string(out.noise) + "); keep hands off during the rest phase and push harder";
+        return false;
+    }
+    // A wide span above the deadzone leaves room for a power curve: fine
+    // control near rest with full force still reaching the top.
+    if (out.full >= 16 * out.deadzone) out.exponent = 1.5;
+    // A push along one axis with a little cross-axis leakage is scaled by
+    // up to sqrt(2) before the curve (see MotionPipeline::flush).
+    out.gain = 0.9 * axis_max / std::pow(out.full * std::sqrt(2.0), out.exponent);
+    return true;
+}
+
+bool parse_wheel_spec(const std::string& s, int& axis, int& units, std::string& err) {
+    static const std::pair<const char*, int> axes[] = {
+        {"x", ABS_X}, {"y", ABS_Y}, {"z", ABS_Z}, {"rx", ABS_RX}, {"ry", ABS_RY}, {"rz", ABS_RZ}};
+    axis = -1;
+    units = 0;
+    if (s.empty() || s == "none") return true;
+    auto parts = split(s, ':');
+    std::string name = parts[0];
+    int sign = 1;
+    if (!name.empty() && name[0] == '-') { sign = -1; name.erase(0, 1); }
+    auto it = std::find_if(std::begin(axes), std::end(axes), [&](const auto& a){ return name == a.first; });
+    double u = AXIS_MAX / 10.0;
+    if (it == std::end(axes) || parts.size() > 2 || (parts.size() == 2 && (!parse_double_strict(parts[1], u) || u < 1 || u > 1e6))) {
+        err = "bad wheel mapping '" + s + "' (want none or [-]<axis>[:<units per detent>])";
+        return false;
+    }
+    axis = it->second;
+    units = sign * static_cast<int>(std::lround(u));
+    return true;
+}
+
+bool DeviceInput::feed(const input_event& ev, ReportDelta& out) {
+    if (ev.type == EV_REL) {
+        switch (ev.code) {
+            case REL_X: acc_dx += ev.value; break;
+            case REL_Y: acc_dy += ev.value; break;
+            case REL_WHEEL: acc_wheel += ev.value; break;
+            case REL_WHEEL_HI_RES: acc_wheel_hi_res += ev.value; wheel_hi_res = true; break;
+            default: return false;
+        }
+        ++rel_in_report;
+        return false;
+    }
+    if (ev.type != EV_SYN) return false;
+    if (ev.code == SYN_DROPPED) {
+        Stats::bump(g_stats.dropped, rel_in_report + 1);
+        acc_dx = acc_dy = acc_wheel = acc_wheel_hi_res = 0;
+        rel_in_report = 0;
+        return false;
+    }
+    if (ev.code != SYN_REPORT) return false;
+    out.dx = int64_t{acc_dx} << Q16;
+    out.dy = int64_t{acc_dy} << Q16;
+    out.wheel = wheel_hi_res ? acc_wheel_hi_res : acc_wheel * WHEEL_HI_RES_PER_DETENT;
+    acc_dx = acc_dy = acc_wheel = acc_wheel_hi_res = 0;
+    wheel_hi_res = false;
+    if (rel_in_report > 1) Stats::bump(g_stats.coalesced, rel_in_report - 1);
+    rel_in_report = 0;
+    map.apply(out.dx, out.dy);
+    return true;
+}
+
+// Locks onto the major input axis while the minor one stays below the lock
+// ratio and keeps it until the minor one reaches the release ratio, so a
+// stroke along one axis does not flicker between locked and free.
+void MotionPipeline::lock_axes(int64_t d[2]) {
+    const int64_t a[2] = {std::llabs(d[0]), std::llabs(d[1])};
+    if (locked >= 0 && a[!locked] * Q16_ONE >= a[locked] * release_q16) locked = -1;
+    const int major = a[1] > a[0];
+    if (locked < 0 && a[!major] * Q16_ONE < a[major] * lock_q16) locked = static_cast<int8_t>(major);
+    if (locked < 0 || d[!locked] == 0) return;
+    Stats::bump(g_stats.axis_locked);
+    d[!locked] = 0;
+    residue[!locked] = 0;
+}
+
+bool MotionPipeline::flush(uint8_t mode, MotionFrame& out) {
+    if (reports == 0) return false;
+    int64_t d[2] = {sum_dx, sum_dy};
+    const int wheel = sum_wheel;
+    sum_dx = sum_dy = 0;
+    sum_wheel = 0;
+    // Reports of other devices (or a backlog of one) merged into this frame.
+    if (reports > 1) Stats::bump(g_stats.coalesced, reports - 1);
+    reports = 0;
+
+    if (filter.kind != FilterKind::NONE) {
+        double v[2] = {static_cast<double>(d[0]) / Q16_ONE, static_cast<double>(d[1]) / Q16_ONE};
+        filter.apply(last_us, v);
+        d[0] = std::llround(v[0] * Q16_ONE);
+        d[1] = std::llround(v[1] * Q16_ONE);
+    }
+
+    out.n = 0;
+    out.pulse = false;
+    out.mode = last_mode;
+    out.mode_changed = false;
+    for (auto& v : d) if (std::llabs(v) < (int64_t{deadzone} << Q16)) v = 0;
+    if (d[0] == 0 && d[1] == 0) {
+        residue[0] = residue[1] = 0;
+        locked = -1;
+        if (wheel == 0 || wheel_axis < 0) {
+            Stats::bump(g_stats.suppressed);
+            return false;
+        }
+    } else {
+        if (lock_q16 > 0) lock_axes(d);
+        if (d[0] && d[1]) {
+            // Keep diagonal speed equal to axis speed: scale by
+            // max(|x|,|y|) * sqrt(2) / (|x| + |y|).
+            const int64_t ax = std::llabs(d[0]), ay = std::llabs(d[1]);
+            const int64_t scale = std::max(ax, ay) * SQRT2_Q16 / (ax + ay);
+            d[0] = d[0] * scale / Q16_ONE;
+            d[1] = d[1] * scale / Q16_ONE;
+        }
+
+        out.mode = mode;
+        out.mode_changed = mode != last_mode;
+        if (out.mode_changed) {
+            Stats::bump(g_stats.mode_switches);
+            last_mode = mode;
+            residue[0] = residue[1] = 0;
+        }
+
+        // Q16 curve output plus the previous frame's remainder; the integer
+        // part, rounded toward zero, is published and the signed fraction
+        // carried. Flooring would turn -0.3 into -1 but 0.3 into 0, biasing
+        // low-force jitter toward negative output.
+        const auto& mc = curves->lut[mode];
+        int s[2];
+        for (int a = 0; a < 2; ++a) {
+            int64_t v = mc[a].eval_q16(d[a]) + residue[a];
+            s[a] = static_cast<int>(v / Q16_ONE);
+            residue[a] = v - (int64_t{s[a]} << Q16);
+        }
+
+        const ModeDef& md = modes->def[mode];
+        for (int i = 0; i < md.n; ++i) {
+            out.axis[i] = md.axis[i];
+            out.value[i] = clamp(md.sign[i] * s[md.src[i]], axis_max);
+        }
+        out.n = md.n;
+    }
+
+    if (wheel != 0 && wheel_axis >= 0) {
+        int64_t q = int64_t{wheel} * wheel_units + wheel_residue;
+        int v = static_cast<int>(q / WHEEL_HI_RES_PER_DETENT);
+        wheel_residue = static_cast<int>(q - int64_t{v} * WHEEL_HI_RES_PER_DETENT);
+        // Whether the mode drives this axis comes from its definition, not
+        // from out.n: a wheel-only report has no motion entries, and a pulse
+        // there would fight the axis's held value.
+        const ModeDef& md = modes->def[out.mode];
+        const bool driven = std::find(md.axis, md.axis + md.n, wheel_axis) != md.axis + md.n;
+        int i = 0;
+        while (i < out.n && out.axis[i] != wheel_axis) ++i;
+        if (i < out.n) {
+            // The mode drives this axis too: add to it, no pulse.
+            out.value[i] = clamp(out.value[i] + v, axis_max);
+        } else if (driven) {
+            // Same without motion, where the mode's share is 0; a step that
+            // only fed the residue leaves the held value alone.
+            if (v != 0) {
+                out.axis[out.n] = static_cast<uint16_t>(wheel_axis);
+                out.value[out.n++] = clamp(v, axis_max);
+            }
+        } else {
+            out.axis[out.n] = static_cast<uint16_t>(wheel_axis);
+            out.value[out.n++] = clamp(v, axis_max);
+            out.pulse = true;
+        }
+    }
+    return out.n > 0;
+}
+
+}  // namespace tp3d
@@ -0,0 +1,712 @@
+#pragma once
+
+#include <linux/input.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The motion pipeline: everything between the raw TrackPoint/keyboard events
+// and the input_events written to uinput, with no device I/O, so the daemon
+// and the replay benchmark run the same code.
+namespace tp3d {
+
+// Default output range; --axis-range widens it.
+constexpr int AXIS_MIN = -5000;
+constexpr int AXIS_MAX = 5000;
+constexpr int DEADZONE = 2;
+
+// Motion deltas are Q16 device counts from the device map on, so fractions
+// from per-device gain, smoothing and the diagonal scale survive to the
+// curve and the remainder of each output is carried to the next frame.
+constexpr int Q16 = 16;
+constexpr int64_t Q16_ONE = int64_t{1} << Q16;
+constexpr int64_t SQRT2_Q16 = 92682;  // sqrt(2) * 65536
+// REL_WHEEL_HI_RES units per wheel detent.
+constexpr int WHEEL_HI_RES_PER_DETENT = 120;
+
+const int ALL_AXES[6] = {ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_RZ};
+
+// Runtime counters and a frame latency histogram for --stats. Everything is
+// a relaxed atomic so any reader can snapshot it without locks; the counters
+// are always maintained, the latency clock is only read when stats are on.
+struct LatencyHistogram {
+    // HDR-style log-linear buckets: 16 linear sub-buckets per power of two,
+    // so any recorded value is within ~6% of its bucket.
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max{0};
+
+    static int index_of(uint64_t v) {
+        if (v < static_cast<uint64_t>(SUB)) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB + static_cast<int>((v >> shift) - SUB);
+    }
+    static uint64_t lower_bound(int idx) {
+        if (idx < SUB) return static_cast<uint64_t>(idx);
+        int shift = idx / SUB - 1;
+        return static_cast<uint64_t>(idx % SUB + SUB) << shift;
+    }
+    void record(uint64_t v) {
+        counts[index_of(v)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t m = max.load(std::memory_order_relaxed);
+        while (v > m && !max.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    }
+    uint64_t percentile(double p) const {
+        uint64_t n = total.load(std::memory_order_relaxed);
+        if (n == 0) return 0;
+        uint64_t want = static_cast<uint64_t>(std::ceil(p * static_cast<double>(n)));
+        if (want == 0) want = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= want) return lower_bound(i);
+        }
+        return max.load(std::memory_order_relaxed);
+    }
+};
+
+struct Stats {
+    bool enabled = false;
+    std::atomic<uint64_t> events_in{0};
+    std::atomic<uint64_t> frames_out{0};
+    std::atomic<uint64_t> syscalls{0};
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> syn_dropped{0};  // kernel buffer overruns (resyncs)
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<uint64_t> mode_switches{0};
+    std::atomic<uint64_t> axis_locked{0};  // frames whose minor axis the lock dropped
+    LatencyHistogram latency_ns;
+    LatencyHistogram passthrough_ns;  // --kbd-grab: kernel timestamp to re-injection
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n = 1) { c.fetch_add(n, std::memory_order_relaxed); }
+    static uint64_t get(const std::atomic<uint64_t>& c) { return c.load(std::memory_order_relaxed); }
+
+    std::string json(double uptime_s) const {
+        std::ostringstream o;
+        auto us = [&](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+        o << "{\"uptime_s\":" << uptime_s
+          << ",\"events_in\":" << get(events_in)
+          << ",\"frames_out\":" << get(frames_out)
+          << ",\"syscalls\":" << get(syscalls)
+          << ",\"wakeups\":" << get(wakeups)
+          << ",\"coalesced\":" << get(coalesced)
+          << ",\"dropped\":" << get(dropped)
+          << ",\"syn_dropped\":" << get(syn_dropped)
+          << ",\"suppressed\":" << get(suppressed)
+          << ",\"mode_switches\":" << get(mode_switches)
+          << ",\"axis_locked\":" << get(axis_locked)
+          << ",\"latency_us\":{\"count\":" << get(latency_ns.total)
+          << ",\"p50\":" << us(latency_ns.percentile(0.50))
+          << ",\"p90\":" << us(latency_ns.percentile(0.90))
+          << ",\"p99\":" << us(latency_ns.percentile(0.99))
+          << ",\"p999\":" << us(latency_ns.percentile(0.999))
+          << ",\"max\":" << us(get(latency_ns.max)) << "}";
+        if (get(passthrough_ns.total)) {
+            o << ",\"passthrough_us\":{\"count\":" << get(passthrough_ns.total)
+              << ",\"p50\":" << us(passthrough_ns.percentile(0.50))
+              << ",\"p99\":" << us(passthrough_ns.percentile(0.99))
+              << ",\"max\":" << us(get(passthrough_ns.max)) << "}";
+        }
+        o << "}";
+        return o.str();
+    }
+};
+
+extern Stats g_stats;
+
+inline int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Collects the input_events of one report and flushes them, SYN included,
+// with a single write(). The last value sent per axis is cached so axes that
+// did not change are not re-sent; a flush with nothing new writes nothing.
+struct FrameBuilder {
+    input_event buf[16];
+    int n = 0;
+    int32_t last_abs[ABS_CNT] = {};
+
+    void add(uint16_t type, uint16_t code, int32_t value) {
+        if (n >= static_cast<int>(sizeof(buf) / sizeof(buf[0])) - 1) return;
+        input_event& ev = buf[n++];
+        ev = input_event{};
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+    }
+    void set_abs(uint16_t code, int32_t value) {
+        for (int i = 0; i < n; ++i) {
+            if (buf[i].type == EV_ABS && buf[i].code == code) {
+                buf[i].value = value;
+                return;
+            }
+        }
+        if (last_abs[code] == value) return;
+        add(EV_ABS, code, value);
+    }
+    // Drops axes that did not change and terminates the report with
+    // SYN_REPORT. Returns the number of events left in buf, 0 if nothing
+    // changed.
+    int finish() {
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (buf[i].type == EV_ABS && buf[i].value == last_abs[buf[i].code]) continue;
+            buf[count++] = buf[i];
+        }
+        n = 0;
+        if (count == 0) return 0;
+        for (int i = 0; i < count; ++i) {
+            if (buf[i].type == EV_ABS) last_abs[buf[i].code] = buf[i].value;
+        }
+        buf[count] = input_event{};
+        buf[count].type = EV_SYN;
+        buf[count].code = SYN_REPORT;
+        return count + 1;
+    }
+    // Returns the number of events written (0 when nothing changed), -1 on error.
+    int flush(int fd) {
+        int count = finish();
+        if (count == 0) return 0;
+        ssize_t len = static_cast<ssize_t>(count * sizeof(input_event));
+        Stats::bump(g_stats.syscalls);
+        if (write(fd, buf, len) != len) {
+            perror("write frame");
+            return -1;
+        }
+        Stats::bump(g_stats.frames_out);
+        return count;
+    }
+};
+
+inline int clamp(int v, int lim = AXIS_MAX) { return std::max(-lim, std::min(lim, v)); }
+
+// Timed output: the values reported per ABS axis since the previous tick are
+// averaged and published on a fixed-rate tick. With a look-ahead, a fresh
+// axis is extrapolated from its change over the last tick to hide part of a
+// frame of latency. Axes not refreshed since the previous tick spring back
+// toward zero with the configured half-life. The caller keeps the timer
+// armed only while some axis is non-zero, so an idle puck costs no wakeups.
+struct OutputStage {
+    int32_t value[ABS_RZ + 1] = {};
+    int32_t prev[ABS_RZ + 1] = {};
+    int64_t sum[ABS_RZ + 1] = {};
+    int32_t count[ABS_RZ + 1] = {};
+    uint32_t pulsed = 0;      // axes published once, then back to 0
+    int32_t decay_q16 = 0;    // per-tick retain factor, 0 = no decay
+    int32_t predict_q16 = 0;  // look-ahead in ticks, 0 = none
+    int axis_max = AXIS_MAX;
+
+    void configure(int rate_hz, int half_life_ms, int predict_ms = 0) {
+        decay_q16 = 0;
+        predict_q16 = 0;
+        if (rate_hz <= 0) return;
+        const double tick_ms = 1000.0 / rate_hz;
+        if (half_life_ms > 0) {
+            double f = std::pow(0.5, tick_ms / half_life_ms);
+            decay_q16 = static_cast<int32_t>(std::lround(f * 65536.0));
+        }
+        if (predict_ms > 0) predict_q16 = static_cast<int32_t>(std::lround(predict_ms / tick_ms * 65536.0));
+    }
+    void set(int axis, int32_t v) {
+        // A held value takes the axis over from a pending wheel pulse; a
+        // pulse sum mixed into the average would be published unscaled.
+        if (pulsed & (1u << axis)) {
+            pulsed &= ~(1u << axis);
+            sum[axis] = 0;
+            count[axis] = 0;
+        }
+        if (count[axis]) Stats::bump(g_stats.coalesced);
+        sum[axis] += v;
+        ++count[axis];
+    }
+    // A relative event (wheel) riding on an absolute axis: summed within the
+    // tick and sent once, with no averaging, decay or prediction.
+    void pulse(int axis, int32_t v) {
+        if (!(pulsed & (1u << axis))) { sum[axis] = 0; count[axis] = 0; }
+        pulsed |= 1u << axis;
+        sum[axis] = clamp(static_cast<int32_t>(sum[axis] + v), axis_max);
+        count[axis] = 1;
+    }
+    void reset() {
+        for (int axis : ALL_AXES) { value[axis] = prev[axis] = 0; sum[axis] = 0; count[axis] = 0; }
+        pulsed = 0;
+    }
+    // Publishes the current values into fb and advances the decay; returns
+    // true while anything is still non-zero.
+    bool tick(FrameBuilder& fb) {
+        bool active = false;
+        for (int axis : ALL_AXES) {
+            int32_t out = value[axis];
+            if (pulsed & (1u << axis)) {
+                out = count[axis] ? clamp(static_cast<int32_t>(sum[axis]), axis_max) : 0;
+                sum[axis] = 0;
+                if (!count[axis]) pulsed &= ~(1u << axis);
+                count[axis] = 0;
+                value[axis] = prev[axis] = 0;
+                fb.set_abs(axis, out);
+                if (out != 0 || fb.last_abs[axis] != 0) active = true;
+                continue;
+            } else if (count[axis]) {
+                value[axis] = clamp(static_cast<int32_t>(sum[axis] / count[axis]), axis_max);
+                sum[axis] = 0;
+                count[axis] = 0;
+                out = value[axis];
+                if (predict_q16) {
+                    int64_t trend = static_cast<int64_t>(value[axis] - prev[axis]) * predict_q16 / 65536;
+                    out = clamp(static_cast<int32_t>(value[axis] + trend), axis_max);
+                }
+            } else if (decay_q16 > 0 && value[axis] != 0) {
+                int32_t p = value[axis];
+                int32_t next = static_cast<int32_t>((static_cast<int64_t>(p) * decay_q16) / 65536);
+                if (next == p) next += p > 0 ? -1 : 1;
+                value[axis] = out = next;
+            }
+            prev[axis] = value[axis];
+            fb.set_abs(axis, out);
+            if (value[axis] != 0 || fb.last_abs[axis] != 0) active = true;
+        }
+        return active;
+    }
+};
+
+// Key-down state for the whole KEY_MAX range in a fixed bitset, so typing
+// never allocates. The bits the motion path needs (modifiers and the grab
+// flag) are mirrored into one atomic word: a frame does a single relaxed load.
+struct KeyState {
+    enum : uint32_t { SHIFT = 1u << 0, CTRL = 1u << 1, ALT = 1u << 2, GRABBED = 1u << 3 };
+    static constexpr uint32_t MOD_MASK = SHIFT | CTRL | ALT;
+
+    uint64_t down[(KEY_MAX + 64) / 64] = {};
+    std::atomic<uint32_t> flags{0};
+
+    static bool is_modifier(int code) {
+        return code == KEY_LEFTSHIFT || code == KEY_RIGHTSHIFT || code == KEY_LEFTCTRL || code == KEY_RIGHTCTRL ||
+               code == KEY_LEFTALT || code == KEY_RIGHTALT;
+    }
+    bool is_down(int code) const { return (down[code >> 6] >> (code & 63)) & 1u; }
+    void set(int code, bool pressed) {
+        if (code < 0 || code > KEY_MAX) return;
+        uint64_t bit = uint64_t{1} << (code & 63);
+        if (pressed) down[code >> 6] |= bit;
+        else down[code >> 6] &= ~bit;
+        switch (code) {
+            case KEY_LEFTSHIFT: case KEY_RIGHTSHIFT:
+                set_flag(SHIFT, is_down(KEY_LEFTSHIFT) || is_down(KEY_RIGHTSHIFT));
+                break;
+            case KEY_LEFTCTRL: case KEY_RIGHTCTRL:
+                set_flag(CTRL, is_down(KEY_LEFTCTRL) || is_down(KEY_RIGHTCTRL));
+                break;
+            case KEY_LEFTALT: case KEY_RIGHTALT:
+                set_flag(ALT, is_down(KEY_LEFTALT) || is_down(KEY_RIGHTALT));
+                break;
+            default:
+                break;
+        }
+    }
+    // Forgets every held key (e.g. the keyboard went away mid-chord); the
+    // grab flag is kept.
+    void release_all() {
+        for (auto& w : down) w = 0;
+        flags.fetch_and(GRABBED, std::memory_order_relaxed);
+    }
+    void set_flag(uint32_t f, bool on) {
+        if (on) flags.fetch_or(f, std::memory_order_relaxed);
+        else flags.fetch_and(~f, std::memory_order_relaxed);
+    }
+    uint32_t load() const { return flags.load(std::memory_order_relaxed); }
+};
+
+// Modes: which output axes, with which signs, the two input axes drive.
+// The table is constexpr by default and --mode can redefine or add entries.
+// The held modifiers index by_mods directly, so picking the mode for a frame
+// is one array load and a mode switch is a change of index.
+constexpr int MAX_MODES = 8;
+constexpr int MODE_OUTPUTS = 4;
+enum : uint8_t { MODE_ORBIT, MODE_TILT, MODE_PAN, BUILTIN_MODES };
+
+struct ModeDef {
+    char name[16] = {};
+    uint8_t n = 0;
+    uint8_t src[MODE_OUTPUTS] = {};  // input axis: 0 = x, 1 = y
+    int8_t sign[MODE_OUTPUTS] = {};
+    uint16_t axis[MODE_OUTPUTS] = {};
+};
+
+struct ModeTable {
+    ModeDef def[MAX_MODES] = {};
+    uint8_t count = 0;
+    uint8_t by_mods[KeyState::MOD_MASK + 1] = {};
+
+    int find(const std::string& name) const {
+        for (int i = 0; i < count; ++i) if (name == def[i].name) return i;
+        return -1;
+    }
+};
+
+constexpr ModeDef make_mode(const char* name, uint16_t ax, int8_t sx, uint16_t ay, int8_t sy) {
+    ModeDef d;
+    for (int i = 0; name[i] && i < 15; ++i) d.name[i] = name[i];
+    d.n = 2;
+    d.src[0] = 0; d.sign[0] = sx; d.axis[0] = ax;
+    d.src[1] = 1; d.sign[1] = sy; d.axis[1] = ay;
+    return d;
+}
+
+// orbit (no modifier), tilt (shift, wins over ctrl), pan (ctrl); alt alone
+// does nothing until a mode is bound to it.
+constexpr ModeTable default_modes() {
+    ModeTable t;
+    t.def[MODE_ORBIT] = make_mode("orbit", ABS_RZ, -1, ABS_RX, -1);
+    t.def[MODE_TILT] = make_mode("tilt", ABS_RY, -1, ABS_Y, -1);
+    t.def[MODE_PAN] = make_mode("pan", ABS_X, 1, ABS_Z, -1);
+    t.count = BUILTIN_MODES;
+    for (uint32_t m = 0; m <= KeyState::MOD_MASK; ++m) {
+        t.by_mods[m] = (m & KeyState::SHIFT) ? MODE_TILT : (m & KeyState::CTRL) ? MODE_PAN : MODE_ORBIT;
+    }
+    return t;
+}
+
+inline constexpr ModeTable DEFAULT_MODES = default_modes();
+
+// Entries `<name>[@<mods>][:<map>]`, separated by ';'. mods is `none` or
+// shift/ctrl/alt joined by '+' and binds that exact combination; map is
+// `<x|y>=[-]<axis>,...` (axis x|y|z|rx|ry|rz, up to four outputs). Naming a
+// built-in mode redefines it; a new name needs a map.
+bool build_modes(const std::vector<std::string>& entries, ModeTable& out, std::string& err);
+
+// Keyboard chords: what a key does besides being a modifier. Bindings sit in
+// a flat table indexed by key code, so a key event costs one load and no
+// allocation; tap timing uses the event timestamps. The engine resolves the
+// active mode on every key change (hold > latch > modifiers) and the motion
+// path only reads the result.
+enum ChordAction : uint8_t { CHORD_NONE, CHORD_TOGGLE, CHORD_HOLD, CHORD_LATCH, CHORD_DOUBLE, CHORD_PRECISION };
+constexpr int MAX_HOLD_KEYS = 16;
+
+struct ChordBinding {
+    uint8_t action = CHORD_NONE;
+    uint8_t mode = 0;
+};
+
+struct ChordTable {
+    ChordBinding key[KEY_MAX + 1] = {};
+    uint16_t hold[MAX_HOLD_KEYS] = {};  // codes bound to hold or precision, to re-resolve on release
+    uint8_t n_hold = 0;
+    int64_t double_us = 300000;
+};
+
+// Entries `<code>=toggle|precision|hold:<mode>|latch:<mode>|double:<mode>`
+// or `double-ms=<ms>`, separated by ';'. hotkey is bound to toggle first.
+bool build_chords(const std::vector<std::string>& entries, int hotkey, const ModeTable& modes, ChordTable& out,
+                  std::string& err);
+
+struct ChordEngine {
+    const ChordTable* table = nullptr;
+    const ModeTable* modes = &DEFAULT_MODES;
+    int hold_key = -1;  // last pressed hold key still down
+    int latched = -1;   // mode latched by latch/double, -1 = none
+    int tap_key = -1;
+    int64_t tap_us = 0;
+    uint8_t mode = MODE_ORBIT;
+    bool precise = false;  // a precision key is held
+
+    void reset() {
+        hold_key = latched = tap_key = -1;
+        tap_us = 0;
+    }
+    // A key transition (value 1 press, 0 release; repeats are ignored) after
+    // keys was updated with it. Returns true when it toggles the grab.
+    bool on_key(int code, int value, int64_t t_us, const KeyState& keys);
+    // Recomputes mode and precise from the held keys and the latch.
+    void resolve(const KeyState& keys);
+};
+
+// Response curves. A curve shapes the magnitude of a raw per-frame delta
+// (in device counts) and the gain is applied on top, so `linear` reproduces
+// the plain `delta * gain` transfer. Raw deltas are small integers, so each
+// curve is compiled once into a lookup table and the hot path costs one
+// array load per axis.
+enum class CurveKind { LINEAR, POWER, SIGMOID, TABLE };
+
+struct CurveSpec {
+    CurveKind kind = CurveKind::LINEAR;
+    double p1 = 1.0;  // power: exponent; sigmoid: midpoint (counts)
+    double p2 = 1.0;  // sigmoid: steepness
+    std::vector<std::pair<double, double>> points;  // table: (in, out) counts
+};
+
+constexpr int CURVE_LUT_SIZE = 256;
+
+struct CurveLut {
+    int32_t y[CURVE_LUT_SIZE];
+    int32_t tail_slope = 0;
+
+    // d and the result are Q16; fractional inputs interpolate linearly
+    // between neighbouring entries.
+    int64_t eval_q16(int64_t d) const {
+        int64_t m = d < 0 ? -d : d;
+        int64_t i = m >> Q16;
+        int64_t f = m & (Q16_ONE - 1);
+        int64_t v = i < CURVE_LUT_SIZE - 1
+                        ? (int64_t{y[i]} << Q16) + (y[i + 1] - y[i]) * f
+                        : (int64_t{y[CURVE_LUT_SIZE - 1]} << Q16) + (m - (int64_t{CURVE_LUT_SIZE - 1} << Q16)) * tail_slope;
+        return d < 0 ? -v : v;
+    }
+};
+
+// One curve per mode and per input axis (0 = x, 1 = y).
+struct CurveSet {
+    CurveLut lut[MAX_MODES][2];
+};
+
+bool parse_double_strict(const std::string& s, double& out);
+std::vector<std::string> split(const std::string& s, char sep);
+// linear | power:<exp> | sigmoid:<mid>[:<k>] | table:<in>:<out>,<in>:<out>,...
+bool parse_curve_spec(const std::string& s, CurveSpec& c, std::string& err);
+CurveLut compile_curve(const CurveSpec& c, double gain);
+// Entries are `[<mode>][.<axis>]=<curve>` or a bare `<curve>` (all modes and
+// axes), separated by ';'. Later entries override earlier ones.
+// Mode names resolve against modes.
+bool build_curves(const std::vector<std::string>& entries, double gain, const ModeTable& modes,
+                  CurveSet& out, std::string& err);
+
+inline int64_t event_time_us(const input_event& ev) {
+    return static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec;
+}
+
+// Optional smoothing stage on the per-report deltas, ahead of the deadzone.
+// Time steps come from the kernel timestamps on the events, so the filter
+// follows the device's real report rate. State is struct-of-arrays over the
+// two input axes; a gap longer than FILTER_RESET_US restarts the filter so a
+// new motion never starts from stale state.
+enum class FilterKind { NONE, EMA, ONE_EURO };
+
+constexpr int64_t FILTER_RESET_US = 100000;
+
+struct MotionFilter {
+    FilterKind kind = FilterKind::NONE;
+    double alpha = 0.5;       // ema
+    double min_cutoff = 1.0;  // one euro, Hz
+    double beta = 0.0;
+    double d_cutoff = 1.0;
+
+    double x[2] = {};
+    double dx[2] = {};
+    int64_t last_us = 0;
+    bool primed = false;
+
+    void reset() { primed = false; }
+
+    static double lp_alpha(double cutoff, double dt) {
+        double tau = 1.0 / (2.0 * M_PI * cutoff);
+        return 1.0 / (1.0 + tau / dt);
+    }
+
+    void apply(int64_t t_us, double v[2]) {
+        if (kind == FilterKind::NONE) return;
+        int64_t gap = t_us - last_us;
+        last_us = t_us;
+        if (!primed || gap <= 0 || gap > FILTER_RESET_US) {
+            for (int i = 0; i < 2; ++i) { x[i] = v[i]; dx[i] = 0.0; }
+            primed = true;
+            return;
+        }
+        if (kind == FilterKind::EMA) {
+            for (int i = 0; i < 2; ++i) {
+                x[i] += alpha * (v[i] - x[i]);
+                v[i] = x[i];
+            }
+            return;
+        }
+        double dt = gap * 1e-6;
+        double ad = lp_alpha(d_cutoff, dt);
+        for (int i = 0; i < 2; ++i) {
+            dx[i] += ad * ((v[i] - x[i]) / dt - dx[i]);
+            double a = lp_alpha(min_cutoff + beta * std::fabs(dx[i]), dt);
+            x[i] += a * (v[i] - x[i]);
+            v[i] = x[i];
+        }
+    }
+};
+
+// none | ema:<alpha> | oneeuro:<min_cutoff>[:<beta>[:<d_cutoff>]]
+bool parse_filter_spec(const std::string& s, MotionFilter& f, std::string& err);
+
+// One processed report: the axes to publish for the resolved mode.
+// A wheel output is a pulse: it holds for one frame and the caller returns
+// that axis to zero afterwards (it is then the last entry).
+struct MotionFrame {
+    uint8_t mode = MODE_ORBIT;
+    bool mode_changed = false;
+    bool pulse = false;
+    int n = 0;
+    uint16_t axis[MODE_OUTPUTS + 1] = {};
+    int32_t value[MODE_OUTPUTS + 1] = {};
+};
+
+// Per-device transform applied to raw deltas before the reports of several
+// pointing devices are merged: gain=<f>,swap,invert-x,invert-y. The gain is
+// Q8 and applied to Q16 deltas, so slow motion is not lost.
+struct DeviceMap {
+    int32_t gain_q8 = 256;
+    bool swap_xy = false;
+    bool invert_x = false;
+    bool invert_y = false;
+
+    void apply(int64_t& dx, int64_t& dy) const {
+        if (swap_xy) std::swap(dx, dy);
+        if (invert_x) dx = -dx;
+        if (invert_y) dy = -dy;
+        if (gain_q8 == 256) return;
+        dx = dx * gain_q8 / 256;
+        dy = dy * gain_q8 / 256;
+    }
+};
+
+bool parse_device_map(const std::string& s, DeviceMap& m, std::string& err);
+
+// One report of a pointing device, as handed from DeviceInput to the
+// pipeline: Q16 deltas and the wheel in REL_WHEEL_HI_RES units.
+struct ReportDelta {
+    int64_t dx = 0;
+    int64_t dy = 0;
+    int wheel = 0;
+};
+
+// One pointing device: REL_X/REL_Y and the wheel of a report are accumulated
+// and handed out, mapped, on SYN_REPORT. Devices with a high-resolution
+// wheel send REL_WHEEL_HI_RES alongside REL_WHEEL; when a report has it, the
+// legacy detent count is ignored.
+struct DeviceInput {
+    DeviceMap map;
+    int acc_dx = 0;
+    int acc_dy = 0;
+    int acc_wheel = 0;
+    int acc_wheel_hi_res = 0;
+    bool wheel_hi_res = false;
+    int rel_in_report = 0;
+
+    void reset() {
+        acc_dx = acc_dy = acc_wheel = acc_wheel_hi_res = 0;
+        wheel_hi_res = false;
+        rel_in_report = 0;
+    }
+    // Feeds one EV_REL/EV_SYN event. Returns true when a SYN_REPORT closed a
+    // report; out then holds its mapped deltas.
+    bool feed(const input_event& ev, ReportDelta& out);
+};
+
+// Shared motion state: the reports added since the last flush, from any
+// number of devices, are summed and turned into a single 6DOF frame (filter,
+// deadzone, diagonal scale, response curve, mode mapping, clamp).
+struct MotionPipeline {
+    const CurveSet* curves = nullptr;
+    const ModeTable* modes = &DEFAULT_MODES;
+    MotionFilter filter;
+    int axis_max = AXIS_MAX;
+    int deadzone = DEADZONE;  // device counts per frame below which an axis is dropped
+    // --wheel: output axis (-1 = off) and signed output units per detent.
+    int wheel_axis = -1;
+    int wheel_units = 0;
+    // --axis-lock: minor/major ratio (Q16) below which the minor input axis
+    // is dropped, and the ratio it must reach to be let through again.
+    int64_t lock_q16 = 0;  // 0 = off
+    int64_t release_q16 = 0;
+    int8_t locked = -1;  // input axis the lock holds, -1 = none
+    int64_t sum_dx = 0;
+    int64_t sum_dy = 0;
+    int sum_wheel = 0;
+    int64_t residue[2] = {};
+    int wheel_residue = 0;
+    int reports = 0;
+    int64_t first_us = 0;
+    int64_t last_us = 0;
+    uint8_t last_mode = MODE_ORBIT;
+
+    void reset() {
+        sum_dx = sum_dy = 0;
+        sum_wheel = 0;
+        residue[0] = residue[1] = 0;
+        wheel_residue = 0;
+        reports = 0;
+        locked = -1;
+        filter.reset();
+    }
+    void add(const ReportDelta& d, int64_t t_us) {
+        if (reports++ == 0) first_us = t_us;
+        last_us = t_us;
+        sum_dx += d.dx;
+        sum_dy += d.dy;
+        sum_wheel += d.wheel;
+    }
+    bool pending() const { return reports > 0; }
+    // Consumes the pending reports for the given mode (ChordEngine::mode).
+    // Returns true when they add up to motion to publish; first_us stays
+    // valid for latency accounting.
+    bool flush(uint8_t mode, MotionFrame& out);
+
+  private:
+    void lock_axes(int64_t d[2]);
+};
+
+// --axis-lock: `none` or `<ratio>[:<release>]`, 0 < ratio < 1 and
+// ratio <= release <= 1 (default release 2 * ratio, at most 1).
+bool parse_axis_lock_spec(const std::string& s, int64_t& lock_q16, int64_t& release_q16, std::string& err);
+
+// --wheel: `none` or `[-]<axis>[:<units per detent>]` (axis x|y|z|rx|ry|rz).
+bool parse_wheel_spec(const std::string& s, int& axis, int& units, std::string& err);
+
+// --calibrate: derives the deadzone, gain and curve from per-report device
+// counts taken at rest (|dx| and |dy|) and while pushing at full force
+// (max(|dx|, |dy|)). Full force (the 99th percentile) lands at 90% of
+// axis_max even after the diagonal scale, so hard pushes do not saturate.
+struct Calibration {
+    int noise = 0;  // 99th percentile at rest
+    int full = 0;
+    int deadzone = DEADZONE;
+    double exponent = 1.0;  // curve power; 1 = linear
+    double gain = 0;
+};
+bool compute_calibration(std::vector<int> rest, std::vector<int> push, int axis_max, Calibration& out,
+                         std::string& err);
+
+// --record capture: a RecordHeader followed by RecordEntry items in native
+// byte order. Timestamps are the kernel event times in microseconds.
+constexpr char RECORD_MAGIC[8] = {'T', 'P', '3', 'D', 'R', 'E', 'C', '1'};
+// The first TP is REC_TP; further TPs are REC_TP_EXTRA + 0, 1, ...
+enum RecordSource : uint8_t { REC_TP = 0, REC_KBD = 1, REC_TP_EXTRA = 2 };
+
+struct RecordHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t hotkey;
+};
+
+struct RecordEntry {
+    int64_t t_us;
+    uint8_t source;
+    uint8_t type;
+    uint16_t code;
+    int32_t value;
+};
+static_assert(sizeof(RecordEntry) == 16, "capture entries are 16 bytes");
+
+}  // namespace tp3d
@@ -0,0 +1,99 @@
+// --calibrate must not hand out settings that saturate: for a range of
+// measured devices, the derived deadzone, gain and curve are run through
+// MotionPipeline with full-force pushes at every angle, diagonal scale
+// included, and every output has to stay below axis_max.
+
+#include "../pipeline.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace tp3d;
+
+namespace {
+
+int failures = 0;
+
+// Rest noise at noise counts, pushes spread up to full (the 99th percentile).
+bool calibrate(int noise, int full, int axis_max, Calibration& cal) {
+    std::vector<int> rest(300), push(500);
+    for (size_t i = 0; i < rest.size(); ++i) rest[i] = static_cast<int>(i % (noise + 1));
+    for (size_t i = 0; i < push.size(); ++i) push[i] = 1 + static_cast<int>((full - 1) * i / (push.size() - 1));
+    std::string err;
+    if (!compute_calibration(rest, push, axis_max, cal, err)) {
+        std::cerr << "noise " << noise << " full " << full << ": " << err << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void check(int noise, int full, int axis_max) {
+    Calibration cal;
+    if (!calibrate(noise, full, axis_max, cal)) {
+        ++failures;
+        return;
+    }
+    // The same text the daemon writes to GAIN= and CURVE=.
+    std::ostringstream curve;
+    if (cal.exponent == 1.0) curve << "linear";
+    else curve << "power:" << cal.exponent;
+    ModeTable modes;
+    CurveSet curves;
+    std::string err;
+    build_modes({}, modes, err);
+    if (!build_curves({curve.str()}, cal.gain, modes, curves, err)) {
+        std::cerr << "curve " << curve.str() << ": " << err << std::endl;
+        ++failures;
+        return;
+    }
+    int worst = 0;
+    for (uint8_t mode = 0; mode < BUILTIN_MODES; ++mode) {
+        for (int minor = 0; minor <= full; ++minor) {
+            for (int sx : {1, -1}) {
+                for (int sy : {1, -1}) {
+                    for (bool swap : {false, true}) {
+                        MotionPipeline p;
+                        p.curves = &curves;
+                        p.modes = &modes;
+                        p.axis_max = axis_max;
+                        p.deadzone = cal.deadzone;
+                        ReportDelta d;
+                        d.dx = int64_t{sx * (swap ? minor : full)} << Q16;
+                        d.dy = int64_t{sy * (swap ? full : minor)} << Q16;
+                        p.add(d, 0);
+                        MotionFrame f;
+                        if (!p.flush(mode, f)) continue;
+                        for (int i = 0; i < f.n; ++i) worst = std::max(worst, std::abs(f.value[i]));
+                    }
+                }
+            }
+        }
+    }
+    if (worst >= axis_max) {
+        std::cerr << "noise " << noise << " full " << full << " axis_max " << axis_max << ": output " << worst
+                  << " saturates (gain " << cal.gain << ", " << curve.str() << ")" << std::endl;
+        ++failures;
+    }
+}
+
+}  // namespace
+
+int main() {
+    for (int axis_max : {AXIS_MAX, 32767}) {
+        for (int noise : {0, 1, 2, 3}) {
+            for (int full : {20, 40, 64, 100, 200, 400}) {
+                check(noise, full, axis_max);
+            }
+        }
+    }
+    if (failures) {
+        std::cerr << failures << " calibrations saturate" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "calibrated settings stay below axis_max" << std::endl;
+    return 0;
+}
@@ -7,18 +7,20 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <cassert>
 #include <cmath>
 #include <cstring>
 #include <cctype>
 #include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <sstream>
-#include <mutex>
 #include <string>
 #include <thread>
-#include <unordered_set>
+#include <map>
+#include <memory>
 #include <vector>
 #include <sys/stat.h>
 #include <limits.h>
@@ -26,21 +28,31 @@
 #include <sys/inotify.h>
 #include <poll.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sched.h>
+
+#include "devices.hpp"
+#include "log.hpp"
+#include "output.hpp"
+#include "pipeline.hpp"
+
+using namespace tp3d;
 
 namespace {
 constexpr int VENDOR_ID = 0x046D;
 constexpr int PRODUCT_ID = 0xC603;
-constexpr int AXIS_MIN = -5000;
-constexpr int AXIS_MAX = 5000;
-constexpr int DEADZONE = 2;
+constexpr const char* DEFAULT_UINPUT_NAME = "TrackPoint-3DMouse";
 constexpr double DEFAULT_GAIN = 60.0;
 constexpr int DEFAULT_HOTKEY = KEY_F8;
 
 constexpr const char* DEFAULT_ENV_DIR = "/etc/trackpoint-3d";
 constexpr const char* DEFAULT_ENV_FILE = "trackpoint-3d.env";
 constexpr const char* DEFAULT_SERVICE_NAME = "trackpoint-3d";
-
-const int ALL_AXES[6] = {ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_RZ};
+constexpr const char* DEFAULT_SELECTION_CACHE = "/var/lib/trackpoint-3d/selection";
 
 static bool parse_index_strict(const std::string& s, size_t& out) {
     if (s.empty()) return false;
@@ -58,10 +70,20 @@ static bool parse_index_strict(const std::string& s, size_t& out) {
     }
 }
 
+// A further --tp device and its per-device map (see DeviceMap).
+struct TpSpec {
+    std::string path;
+    std::string map;
+};
+
 struct Args {
     std::string tp_path;
+    std::string tp_map;
+    std::vector<TpSpec> tp_extra;
+    bool tp_all = false;
     std::string kbd_path;
     double gain = DEFAULT_GAIN;
+    int deadzone = DEADZONE;
     int hotkey = DEFAULT_HOTKEY;
     bool install = false;
     bool auto_detect = false;
@@ -70,66 +92,223 @@ struct Args {
     std::string on_missing = "fail";
     int wait_secs = 0;
     bool list_devices = false;
+    bool calibrate = false;
     std::string install_path = "/usr/local/bin/trackpoint-3d";
     std::string service_name = DEFAULT_SERVICE_NAME;
     std::string env_dir = DEFAULT_ENV_DIR;
+    std::vector<std::string> curves;
+    std::vector<std::string> modes;
+    std::vector<std::string> chords;
+    int rate_hz = 0;
+    int decay_ms = 0;
+    int predict_ms = 0;
+    std::string filter = "none";
+    std::string wheel = "none";
+    std::string axis_lock = "none";
+    double precision = 0.25;
+    std::string log_level = "info";
+    bool stats = false;
+    int stats_interval = 10;
+    std::string record_path;
+    int rt_priority = 0;
+    std::string rt_policy = "fifo";
+    std::string cpus;
+    bool mlock = false;
+    bool kbd_grab = false;
+    int nice = 0;
+    int axis_range = AXIS_MAX;
+    std::string abs_fuzz;
+    std::string abs_flat;
+    std::string abs_res;
+    std::string output = "uinput";
+    std::string spnav_socket = DEFAULT_SPNAV_SOCKET;
+    std::string uinput_name = DEFAULT_UINPUT_NAME;
+    std::string uinput_id;
+    std::vector<std::string> seats;
+    std::string selection_cache = DEFAULT_SELECTION_CACHE;
+    std::string config_path;
 };
 
-static bool g_show_install = true;
+static bool show_install();
 
 void usage(const char* prog) {
     std::cerr << "Usage: " << prog
               << " [--tp <path>|auto] [--kbd <path>|auto] [options]\n\n"
               << "Options:\n"
+              << "  --tp <path>[@<map>]    Pointing device (repeatable, or ';'-separated); all merge\n"
+              << "                         into one output. map: gain=<f>,swap,invert-x,invert-y\n"
               << "  --gain <float>         Scale factor for deltas (default 60)\n"
+              << "  --deadzone <counts>    Drop per-frame deltas below this many counts (default 2)\n"
               << "  --hotkey <keycode>     EV_KEY code to toggle grab (default KEY_F8)\n"
+              << "  --curve <spec>         Response curve, [mode][.axis]=<curve>;... (repeatable)\n"
+              << "                         curve: linear|power:<exp>|sigmoid:<mid>[:<k>]|table:<in>:<out>,...\n"
+              << "  --mode <spec>          Modes, <name>[@<mods>][:<in>=[-]<axis>,...];... (repeatable)\n"
+              << "                         mods: none|shift|ctrl|alt joined by +, e.g. roll@alt:x=-ry\n"
+              << "  --chord <spec>         Key bindings, <code>=toggle|hold:<mode>|latch:<mode>|double:<mode>\n"
+              << "                         or precision or double-ms=<ms>;... (repeatable), e.g. 58=hold:pan\n"
+              << "  --precision <factor>   Gain factor while a precision chord key is held (default 0.25)\n"
+              << "  --axis-lock <spec>     Drop the minor input axis: none|<ratio>[:<release>] (e.g. 0.3)\n"
+              << "  --filter <spec>        Smoothing: none|ema:<alpha>|oneeuro:<min_cutoff>[:<beta>[:<d_cutoff>]]\n"
+              << "  --rate <Hz>            Publish frames on a fixed-rate timer (0=per input report)\n"
+              << "  --decay-ms <ms>        Spring-back half-life for idle axes (0=off, implies --rate 250)\n"
+              << "  --predict-ms <ms>      With --rate, extrapolate each frame this far ahead (0-50, default 0)\n"
+              << "  --wheel <spec>         Scroll wheel to an axis: none|[-]<axis>[:<units per detent>] (default none)\n"
+              << "  --axis-range <N>       Output axes span -N..N (default 5000)\n"
+              << "  --abs-fuzz <spec>      Kernel fuzz per axis: <n> or <axis>=<n>,... (axis x|y|z|rx|ry|rz)\n"
+              << "  --abs-flat <spec>      Flat (dead) zone advertised per axis, same syntax\n"
+              << "  --abs-res <spec>       Resolution advertised per axis, same syntax\n"
+              << "  --output <backend>     uinput (virtual device for spacenavd) or spnav (serve clients directly)\n"
+              << "  --spnav-socket <path>  Socket for --output spnav (default /var/run/spnav.sock)\n"
+              << "  --uinput-name <name>   Name of the virtual device (default TrackPoint-3DMouse)\n"
+              << "  --uinput-id <vid:pid>  USB ids it reports, in hex (default 046d:c603)\n"
+              << "  --seat <env file>      Run one pipeline per file (repeatable) from a single process;\n"
+              << "                         each file names its own TP_EVENT/KBD_EVENT and is live-reloaded\n"
+              << "  --stats                Collect latency/throughput stats; dump JSON on SIGUSR1\n"
+              << "  --stats-interval <s>   Also dump stats every s seconds (default 10, 0=SIGUSR1 only)\n"
+              << "  --log-level <level>    error|warn|info|debug (default info)\n"
+              << "  --record <file>        Capture raw TP/KBD events for the replay benchmark\n"
+              << "  --rt-priority <N>      Run the input loop with real-time priority N (1-99)\n"
+              << "  --rt-policy <p>        fifo|rr (default fifo)\n"
+              << "  --cpu <list>           Pin to CPUs, e.g. 2 or 0,2-3\n"
+              << "  --mlock                Lock all memory to avoid page faults in the input loop\n"
+              << "  --nice <N>             Nice value (-20..19)\n"
+              << "  --config <env file>    Read settings from the env file (command line wins);\n"
+              << "                         reloaded on SIGHUP and when the file changes\n"
               << "  --auto                 Autodetect TP and KBD devices\n"
               << "  --tp-match <substr>    Ordered match for TP (repeatable)\n"
+              << "  --tp-all               Use every TP matching a --tp-match rule, not just the first\n"
               << "  --kbd-match <substr>   Ordered match for KBD (repeatable)\n"
+              << "  --kbd-grab             Grab the keyboard and re-inject every key but the chord keys\n"
+              << "                         (and, while capturing, the modifiers) through a virtual keyboard\n"
               << "  --on-missing <policy>  fail|fallback|wait|interactive (default fail)\n"
               << "  --wait-secs <N>        Wait seconds if --on-missing=wait (0=forever)\n"
+              << "  --selection-cache <f>  Where auto selection remembers its devices, or none\n"
+              << "                         (default /var/lib/trackpoint-3d/selection)\n"
               << "  --list-devices         List candidates and exit\n"
-              << (g_show_install ? "\nInstall (run as root):\n  --install              Install binary + systemd service (one-time)\n  --install-path <path>  Install binary path (default /usr/local/bin/trackpoint-3d)\n  --service-name <name>  Systemd unit base name (default trackpoint-3d)\n  --env-dir <dir>        Directory for .env file (default /etc/trackpoint-3d)\n" : "")
+              << "  --calibrate            Measure the TP at rest and at full force, save DEADZONE/GAIN/CURVE\n"
+              << "                         to the env file (--config, else --env-dir) and exit\n"
+              << (show_install() ? "\nInstall (run as root):\n  --install              Install binary + systemd service (one-time)\n  --install-path <path>  Install binary path (default /usr/local/bin/trackpoint-3d)\n  --service-name <name>  Systemd unit base name (default trackpoint-3d)\n  --env-dir <dir>        Directory for .env file (default /etc/trackpoint-3d)\n" : "")
               << std::endl;
     std::exit(EXIT_FAILURE);
 }
 
-Args parse_args(int argc, char** argv) {
+// av holds the arguments without the program name.
+Args parse_args(const std::vector<std::string>& av, const char* prog) {
     Args a;
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
+    const int argc = static_cast<int>(av.size());
+    for (int i = 0; i < argc; ++i) {
+        const std::string& arg = av[i];
         if (arg == "--tp" && i + 1 < argc) {
-            a.tp_path = argv[++i];
+            // The first device is the primary TP (the one autodetect fills).
+            for (const auto& spec : split(av[++i], ';')) {
+                if (spec.empty()) continue;
+                auto at = spec.rfind('@');
+                TpSpec t{spec.substr(0, at), at == std::string::npos ? "" : spec.substr(at + 1)};
+                if (a.tp_path.empty()) {
+                    a.tp_path = t.path;
+                    a.tp_map = t.map;
+                } else {
+                    a.tp_extra.push_back(t);
+                }
+            }
         } else if (arg == "--kbd" && i + 1 < argc) {
-            a.kbd_path = argv[++i];
+            a.kbd_path = av[++i];
         } else if (arg == "--gain" && i + 1 < argc) {
-            a.gain = std::stod(argv[++i]);
+            a.gain = std::stod(av[++i]);
+        } else if (arg == "--deadzone" && i + 1 < argc) {
+            a.deadzone = std::stoi(av[++i]);
         } else if (arg == "--hotkey" && i + 1 < argc) {
-            a.hotkey = std::stoi(argv[++i]);
+            a.hotkey = std::stoi(av[++i]);
+        } else if (arg == "--curve" && i + 1 < argc) {
+            a.curves.push_back(av[++i]);
+        } else if (arg == "--mode" && i + 1 < argc) {
+            a.modes.push_back(av[++i]);
+        } else if (arg == "--chord" && i + 1 < argc) {
+            a.chords.push_back(av[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            a.filter = av[++i];
+        } else if (arg == "--rate" && i + 1 < argc) {
+            a.rate_hz = std::stoi(av[++i]);
+        } else if (arg == "--decay-ms" && i + 1 < argc) {
+            a.decay_ms = std::stoi(av[++i]);
+        } else if (arg == "--predict-ms" && i + 1 < argc) {
+            a.predict_ms = std::stoi(av[++i]);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            a.log_level = av[++i];
+        } else if (arg == "--wheel" && i + 1 < argc) {
+            a.wheel = av[++i];
+        } else if (arg == "--axis-lock" && i + 1 < argc) {
+            a.axis_lock = av[++i];
+        } else if (arg == "--precision" && i + 1 < argc) {
+            a.precision = std::stod(av[++i]);
+        } else if (arg == "--uinput-name" && i + 1 < argc) {
+            a.uinput_name = av[++i];
+        } else if (arg == "--uinput-id" && i + 1 < argc) {
+            a.uinput_id = av[++i];
+        } else if (arg == "--seat" && i + 1 < argc) {
+            a.seats.push_back(av[++i]);
+        } else if (arg == "--axis-range" && i + 1 < argc) {
+            a.axis_range = std::stoi(av[++i]);
+        } else if (arg == "--abs-fuzz" && i + 1 < argc) {
+            a.abs_fuzz = av[++i];
+        } else if (arg == "--abs-flat" && i + 1 < argc) {
+            a.abs_flat = av[++i];
+        } else if (arg == "--abs-res" && i + 1 < argc) {
+            a.abs_res = av[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            a.output = av[++i];
+        } else if (arg == "--spnav-socket" && i + 1 < argc) {
+            a.spnav_socket = av[++i];
+        } else if (arg == "--stats") {
+            a.stats = true;
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            a.stats_interval = std::stoi(av[++i]);
+        } else if (arg == "--record" && i + 1 < argc) {
+            a.record_path = av[++i];
+        } else if (arg == "--rt-priority" && i + 1 < argc) {
+            a.rt_priority = std::stoi(av[++i]);
+        } else if (arg == "--rt-policy" && i + 1 < argc) {
+            a.rt_policy = av[++i];
+        } else if (arg == "--cpu" && i + 1 < argc) {
+            a.cpus = av[++i];
+        } else if (arg == "--mlock") {
+            a.mlock = true;
+        } else if (arg == "--kbd-grab") {
+            a.kbd_grab = true;
+        } else if (arg == "--nice" && i + 1 < argc) {
+            a.nice = std::stoi(av[++i]);
         } else if (arg == "--auto") {
             a.auto_detect = true;
         } else if (arg == "--tp-match" && i + 1 < argc) {
-            a.tp_matches.push_back(argv[++i]);
+            a.tp_matches.push_back(av[++i]);
+        } else if (arg == "--tp-all") {
+            a.tp_all = true;
         } else if (arg == "--kbd-match" && i + 1 < argc) {
-            a.kbd_matches.push_back(argv[++i]);
+            a.kbd_matches.push_back(av[++i]);
         } else if (arg == "--on-missing" && i + 1 < argc) {
-            a.on_missing = argv[++i];
+            a.on_missing = av[++i];
         } else if (arg == "--wait-secs" && i + 1 < argc) {
-            a.wait_secs = std::stoi(argv[++i]);
+            a.wait_secs = std::stoi(av[++i]);
         } else if (arg == "--list-devices") {
             a.list_devices = true;
+        } else if (arg == "--calibrate") {
+            a.calibrate = true;
+        } else if (arg == "--selection-cache" && i + 1 < argc) {
+            a.selection_cache = av[++i];
+        } else if (arg == "--config" && i + 1 < argc) {
+            a.config_path = av[++i];
         } else if (arg == "--install") {
             a.install = true;
         } else if (arg == "--install-path" && i + 1 < argc) {
-            a.install_path = argv[++i];
+            a.install_path = av[++i];
         } else if (arg == "--service-name" && i + 1 < argc) {
-            a.service_name = argv[++i];
+            a.service_name = av[++i];
         } else if (arg == "--env-dir" && i + 1 < argc) {
-            a.env_dir = argv[++i];
+            a.env_dir = av[++i];
         } else if (arg == "--help" || arg == "-h") {
-            usage(argv[0]);
+            usage(prog);
         } else {
-            usage(argv[0]);
+            usage(prog);
         }
     }
     return a;
@@ -137,6 +316,224 @@ Args parse_args(int argc, char** argv) {
 
 std::string read_self_path();
 
+using EnvMap = std::map<std::string, std::string>;
+
+// KEY=VALUE lines; blank lines and # comments are skipped and surrounding
+// quotes stripped, as systemd's EnvironmentFile does.
+static bool read_env_file(const std::string& path, EnvMap& out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    out.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        auto b = line.find_first_not_of(" \t");
+        if (b == std::string::npos || line[b] == '#') continue;
+        auto eq = line.find('=', b);
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(b, eq - b);
+        std::string val = line.substr(eq + 1);
+        while (!key.empty() && (key.back() == ' ' || key.back() == '\t')) key.pop_back();
+        if (val.size() >= 2 && (val[0] == '"' || val[0] == '\'') && val.back() == val[0]) val = val.substr(1, val.size() - 2);
+        out[key] = val;
+    }
+    return true;
+}
+
+// Env keys and the options they stand for. Empty values are left out so the
+// built-in defaults apply.
+const std::pair<const char*, const char*> ENV_OPTIONS[] = {
+    {"TP_EVENT", "--tp"}, {"KBD_EVENT", "--kbd"}, {"GAIN", "--gain"}, {"DEADZONE", "--deadzone"}, {"HOTKEY", "--hotkey"},
+    {"CURVE", "--curve"}, {"MODES", "--mode"}, {"CHORDS", "--chord"}, {"AXIS_LOCK", "--axis-lock"}, {"PRECISION", "--precision"}, {"RATE_HZ", "--rate"}, {"DECAY_MS", "--decay-ms"}, {"PREDICT_MS", "--predict-ms"},
+    {"FILTER", "--filter"}, {"WHEEL", "--wheel"}, {"AXIS_RANGE", "--axis-range"}, {"ABS_FUZZ", "--abs-fuzz"}, {"ABS_FLAT", "--abs-flat"},
+    {"ABS_RES", "--abs-res"}, {"OUTPUT", "--output"}, {"SPNAV_SOCKET", "--spnav-socket"},
+    {"LOG_LEVEL", "--log-level"}, {"UINPUT_NAME", "--uinput-name"}, {"UINPUT_ID", "--uinput-id"}};
+// Settings a reload cannot apply: they shape the devices themselves.
+const char* const ENV_RESTART_ONLY[] = {"TP_EVENT", "KBD_EVENT", "RATE_HZ", "MLOCK", "AXIS_RANGE",
+                                        "ABS_FUZZ", "ABS_FLAT", "ABS_RES", "OUTPUT", "SPNAV_SOCKET",
+                                        "UINPUT_NAME", "UINPUT_ID", "KBD_GRAB"};
+
+static std::vector<std::string> env_to_args(const EnvMap& env) {
+    std::vector<std::string> out;
+    for (const auto& o : ENV_OPTIONS) {
+        auto it = env.find(o.first);
+        if (it == env.end() || it->second.empty()) continue;
+        out.push_back(o.second);
+        out.push_back(it->second);
+    }
+    auto m = env.find("MLOCK");
+    if (m != env.end() && !m->second.empty()) out.push_back("--mlock");
+    auto g = env.find("KBD_GRAB");
+    if (g != env.end() && !g->second.empty()) out.push_back("--kbd-grab");
+    return out;
+}
+
+// The env file (if --config names one) followed by the command line, so the
+// command line wins.
+static Args load_args(const std::vector<std::string>& cli, const char* prog, EnvMap& env) {
+    Args a = parse_args(cli, prog);
+    if (a.config_path.empty()) return a;
+    if (!read_env_file(a.config_path, env)) {
+        std::cerr << "cannot read --config file " << a.config_path << ": " << std::strerror(errno) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    auto av = env_to_args(env);
+    av.insert(av.end(), cli.begin(), cli.end());
+    return parse_args(av, prog);
+}
+
+// "0,2-3" -> {0, 2, 3}
+static bool parse_cpu_list(const std::string& s, std::vector<int>& out) {
+    out.clear();
+    for (const auto& part : split(s, ',')) {
+        auto dash = part.find('-');
+        size_t lo = 0, hi = 0;
+        if (dash == std::string::npos) {
+            if (!parse_index_strict(part, lo)) return false;
+            hi = lo;
+        } else if (!parse_index_strict(part.substr(0, dash), lo) || !parse_index_strict(part.substr(dash + 1), hi) || hi < lo) {
+            return false;
+        }
+        if (hi >= CPU_SETSIZE) return false;
+        for (size_t c = lo; c <= hi; ++c) out.push_back(static_cast<int>(c));
+    }
+    return !out.empty();
+}
+
+// Applies --nice, --cpu, --rt-priority and --mlock to the running process.
+static bool apply_scheduling(const Args& a) {
+    if (a.nice != 0 && setpriority(PRIO_PROCESS, 0, a.nice) != 0) {
+        perror("setpriority");
+        return false;
+    }
+    if (!a.cpus.empty()) {
+        std::vector<int> cpus;
+        parse_cpu_list(a.cpus, cpus);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus) CPU_SET(c, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            perror("sched_setaffinity");
+            return false;
+        }
+    }
+    if (a.rt_priority > 0) {
+        sched_param sp{};
+        sp.sched_priority = a.rt_priority;
+        if (sched_setscheduler(0, a.rt_policy == "rr" ? SCHED_RR : SCHED_FIFO, &sp) != 0) {
+            perror("sched_setscheduler");
+            return false;
+        }
+    }
+    if (a.mlock && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+        return false;
+    }
+    return true;
+}
+
+// Name and the capabilities autodetection cares about for one evdev node.
+struct Probe {
+    std::string name;
+    bool has_rel_xy = false;
+    bool has_keys = false;
+};
+
+static Probe probe_evdev(const std::string& path) {
+    Probe p;
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return p;
+    libevdev* dev = nullptr;
+    if (libevdev_new_from_fd(fd, &dev) == 0 && dev) {
+        const char* nm = libevdev_get_name(dev);
+        if (nm) p.name = nm;
+        if (libevdev_has_event_type(dev, EV_REL)) {
+            if (libevdev_has_event_code(dev, EV_REL, REL_X) && libevdev_has_event_code(dev, EV_REL, REL_Y)) p.has_rel_xy = true;
+        }
+        if (libevdev_has_event_type(dev, EV_KEY)) p.has_keys = true;
+        libevdev_free(dev);
+    }
+    close(fd);
+    return p;
+}
+
+// Probe results keyed by the identity of the resolved node (st_rdev, inode,
+// ctime). The by-id and by-path links of one device share an entry, repeated
+// scans cost one stat() per link, and a node that was re-created or had its
+// permissions changed by udev gets a new key and so is probed again.
+struct ProbeCache {
+    struct Key {
+        dev_t rdev;
+        ino_t ino;
+        time_t ctime_sec;
+        long ctime_nsec;
+        bool operator<(const Key& o) const {
+            if (rdev != o.rdev) return rdev < o.rdev;
+            if (ino != o.ino) return ino < o.ino;
+            if (ctime_sec != o.ctime_sec) return ctime_sec < o.ctime_sec;
+            return ctime_nsec < o.ctime_nsec;
+        }
+    };
+    std::map<Key, Probe> entries;
+
+    static bool key_of(const std::string& path, Key& k) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISCHR(st.st_mode)) return false;
+        k = Key{st.st_rdev, st.st_ino, st.st_ctim.tv_sec, st.st_ctim.tv_nsec};
+        return true;
+    }
+    const Probe& get(const std::string& path) {
+        static const Probe missing;
+        Key k;
+        if (!key_of(path, k)) return missing;
+        auto it = entries.find(k);
+        if (it != entries.end()) return it->second;
+        return store(k, probe_evdev(path));
+    }
+
+    // Probes every uncached node among paths concurrently on a bounded pool
+    // of workers. Slow devices (Bluetooth, some receivers) take tens of ms to
+    // answer the init ioctls; this makes a scan cost the slowest probe, not
+    // the sum. Results land in the cache; callers keep their own ordering.
+    void prefetch(const std::vector<std::string>& paths) {
+        std::vector<std::pair<Key, std::string>> todo;
+        for (const auto& path : paths) {
+            Key k;
+            if (!key_of(path, k) || entries.count(k)) continue;
+            bool queued = false;
+            for (const auto& t : todo) {
+                if (!(t.first < k) && !(k < t.first)) { queued = true; break; }
+            }
+            if (!queued) todo.emplace_back(k, path);
+        }
+        if (todo.size() < 2) return;
+        std::vector<Probe> results(todo.size());
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < todo.size();) {
+                results[i] = probe_evdev(todo[i].second);
+            }
+        };
+        const size_t workers = std::min(todo.size(), MAX_PROBE_WORKERS);
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < workers; ++w) pool.emplace_back(work);
+        work();
+        for (auto& t : pool) t.join();
+        for (size_t i = 0; i < todo.size(); ++i) store(todo[i].first, std::move(results[i]));
+    }
+
+  private:
+    static constexpr size_t MAX_PROBE_WORKERS = 8;
+
+    const Probe& store(const Key& k, Probe p) {
+        // Drop the stale entry of a node whose identity changed.
+        for (auto e = entries.begin(); e != entries.end();) {
+            if (e->first.rdev == k.rdev) e = entries.erase(e);
+            else ++e;
+        }
+        return entries.emplace(k, std::move(p)).first->second;
+    }
+};
+
 static bool run_cmd_ok(const std::string& cmd, const char* action) {
     int rc = system(cmd.c_str());
     if (rc == -1) {
@@ -170,28 +567,73 @@ static bool is_installed_copy(const std::string& service_name) {
     return content.find(self) != std::string::npos;
 }
 
-void emit(int fd, uint16_t type, uint16_t code, int32_t value, bool syn = true) {
-    input_event ev{};
-    ev.type = type;
-    ev.code = code;
-    ev.value = value;
-    if (write(fd, &ev, sizeof(ev)) < 0) {
-        perror("write event");
+// Only usage and --install need it; a plain start skips the unit file read.
+static bool show_install() {
+    static const bool show = !is_installed_copy(DEFAULT_SERVICE_NAME);
+    return show;
+}
+
+// absinfo of the output axes. With a non-zero fuzz the kernel drops (and
+// smooths) changes smaller than it before any evdev reader wakes up.
+struct AbsConfig {
+    int range = AXIS_MAX;
+    int fuzz[ABS_CNT] = {};
+    int flat[ABS_CNT] = {};
+    int resolution[ABS_CNT] = {};
+};
+
+// Name and id the virtual device is created with.
+struct DeviceIdentity {
+    std::string name = DEFAULT_UINPUT_NAME;
+    uint16_t vendor = VENDOR_ID;
+    uint16_t product = PRODUCT_ID;
+};
+
+// "046d:c603"; empty keeps the default.
+static bool parse_uinput_id(const std::string& s, DeviceIdentity& id) {
+    if (s.empty()) return true;
+    auto parts = split(s, ':');
+    if (parts.size() != 2) return false;
+    uint16_t v[2];
+    for (int i = 0; i < 2; ++i) {
+        const std::string& p = parts[static_cast<size_t>(i)];
+        if (p.empty() || p.size() > 4 || p.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) return false;
+        v[i] = static_cast<uint16_t>(std::stoul(p, nullptr, 16));
     }
-    if (syn) {
-        input_event se{};
-        se.type = EV_SYN;
-        se.code = SYN_REPORT;
-        se.value = 0;
-        if (write(fd, &se, sizeof(se)) < 0) {
-            perror("write syn");
+    id.vendor = v[0];
+    id.product = v[1];
+    return true;
+}
+
+// "4" sets every output axis, "rx=2,rz=2" single ones; items apply in order.
+static bool parse_axis_values(const std::string& s, int* out, std::string& err) {
+    static const std::pair<const char*, int> names[] = {
+        {"x", ABS_X}, {"y", ABS_Y}, {"z", ABS_Z}, {"rx", ABS_RX}, {"ry", ABS_RY}, {"rz", ABS_RZ}};
+    for (const auto& item : split(s, ',')) {
+        auto eq = item.find('=');
+        size_t v = 0;
+        if (!parse_index_strict(eq == std::string::npos ? item : item.substr(eq + 1), v) || v > 1000000) {
+            err = "bad value in '" + item + "'";
+            return false;
+        }
+        if (eq == std::string::npos) {
+            for (int axis : ALL_AXES) out[axis] = static_cast<int>(v);
+            continue;
+        }
+        const std::string name = item.substr(0, eq);
+        auto it = std::find_if(std::begin(names), std::end(names), [&](const auto& n){ return name == n.first; });
+        if (it == std::end(names)) {
+            err = "unknown axis '" + name + "' (want x, y, z, rx, ry or rz)";
+            return false;
         }
+        out[it->second] = static_cast<int>(v);
     }
+    return true;
 }
 
-int clamp(int v) { return std::max(AXIS_MIN, std::min(AXIS_MAX, v)); }
-
-int setup_uinput() {
+// Kernels before 4.5 (uinput version 5) only take the legacy uinput_user_dev
+// write; everything newer gets UI_ABS_SETUP per axis and UI_DEV_SETUP.
+int setup_uinput(const AbsConfig& abs, const DeviceIdentity& ident) {
     int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
     if (fd < 0) {
         perror("open /dev/uinput");
@@ -207,56 +649,884 @@ int setup_uinput() {
         ioctl(fd, UI_SET_ABSBIT, axis);
     }
 
-    uinput_user_dev uidev{};
-    std::snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "TrackPoint-3DMouse");
-    uidev.id.bustype = BUS_USB;
-    uidev.id.vendor = VENDOR_ID;
-    uidev.id.product = PRODUCT_ID;
-    uidev.id.version = 1;
+    input_id id{};
+    id.bustype = BUS_USB;
+    id.vendor = ident.vendor;
+    id.product = ident.product;
+    id.version = 1;
+
+    unsigned int version = 0;
+    if (ioctl(fd, UI_GET_VERSION, &version) == 0 && version >= 5) {
+        for (int axis : ALL_AXES) {
+            uinput_abs_setup as{};
+            as.code = static_cast<uint16_t>(axis);
+            as.absinfo.minimum = -abs.range;
+            as.absinfo.maximum = abs.range;
+            as.absinfo.fuzz = abs.fuzz[axis];
+            as.absinfo.flat = abs.flat[axis];
+            as.absinfo.resolution = abs.resolution[axis];
+            if (ioctl(fd, UI_ABS_SETUP, &as) < 0) {
+                perror("UI_ABS_SETUP");
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        uinput_setup us{};
+        std::snprintf(us.name, UINPUT_MAX_NAME_SIZE, "%s", ident.name.c_str());
+        us.id = id;
+        if (ioctl(fd, UI_DEV_SETUP, &us) < 0) {
+            perror("UI_DEV_SETUP");
+            std::exit(EXIT_FAILURE);
+        }
+    } else {
+        // The legacy struct has no resolution field.
+        uinput_user_dev uidev{};
+        std::snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "%s", ident.name.c_str());
+        uidev.id = id;
+        for (int axis : ALL_AXES) {
+            uidev.absmin[axis] = -abs.range;
+            uidev.absmax[axis] = abs.range;
+            uidev.absfuzz[axis] = abs.fuzz[axis];
+            uidev.absflat[axis] = abs.flat[axis];
+        }
+        if (write(fd, &uidev, sizeof(uidev)) < 0) {
+            perror("write uidev");
+            std::exit(EXIT_FAILURE);
+        }
+    }
 
-    for (int axis : ALL_AXES) {
-        uidev.absmin[axis] = AXIS_MIN;
-        uidev.absmax[axis] = AXIS_MAX;
-        uidev.absfuzz[axis] = 0;
-        uidev.absflat[axis] = 0;
+    if (ioctl(fd, UI_DEV_CREATE) < 0) {
+        perror("UI_DEV_CREATE");
+        std::exit(EXIT_FAILURE);
     }
+    return fd;
+}
 
-    if (write(fd, &uidev, sizeof(uidev)) < 0) {
-        perror("write uidev");
+// --kbd-grab: a virtual keyboard with the keys and LEDs of src. It reports
+// the source ids on BUS_VIRTUAL; opened read-write so LED changes the host
+// makes can be passed back to the real keyboard.
+int setup_uinput_keyboard(libevdev* src) {
+    int fd = open("/dev/uinput", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        perror("open /dev/uinput");
         std::exit(EXIT_FAILURE);
     }
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    for (int code = 0; code <= KEY_MAX; ++code) {
+        if (libevdev_has_event_code(src, EV_KEY, code)) ioctl(fd, UI_SET_KEYBIT, code);
+    }
+    if (libevdev_has_event_type(src, EV_LED)) {
+        ioctl(fd, UI_SET_EVBIT, EV_LED);
+        for (int code = 0; code <= LED_MAX; ++code) {
+            if (libevdev_has_event_code(src, EV_LED, code)) ioctl(fd, UI_SET_LEDBIT, code);
+        }
+    }
 
+    input_id id{};
+    id.bustype = BUS_VIRTUAL;
+    id.vendor = static_cast<uint16_t>(libevdev_get_id_vendor(src));
+    id.product = static_cast<uint16_t>(libevdev_get_id_product(src));
+    id.version = 1;
+    const char* nm = libevdev_get_name(src);
+    const std::string name = std::string(nm ? nm : "keyboard") + " (trackpoint-3d)";
+
+    unsigned int version = 0;
+    if (ioctl(fd, UI_GET_VERSION, &version) == 0 && version >= 5) {
+        uinput_setup us{};
+        std::snprintf(us.name, UINPUT_MAX_NAME_SIZE, "%s", name.c_str());
+        us.id = id;
+        if (ioctl(fd, UI_DEV_SETUP, &us) < 0) {
+            perror("UI_DEV_SETUP (keyboard)");
+            std::exit(EXIT_FAILURE);
+        }
+    } else {
+        uinput_user_dev uidev{};
+        std::snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "%s", name.c_str());
+        uidev.id = id;
+        if (write(fd, &uidev, sizeof(uidev)) < 0) {
+            perror("write uidev (keyboard)");
+            std::exit(EXIT_FAILURE);
+        }
+    }
     if (ioctl(fd, UI_DEV_CREATE) < 0) {
-        perror("UI_DEV_CREATE");
+        perror("UI_DEV_CREATE (keyboard)");
         std::exit(EXIT_FAILURE);
     }
     return fd;
 }
 
-void zero_all_axes(int ufd) {
-    for (int i = 0; i < 6; ++i) {
-        emit(ufd, EV_ABS, ALL_AXES[i], 0, false);
-    }
-    emit(ufd, EV_SYN, SYN_REPORT, 0, true);
+void zero_all_axes(FrameBuilder& fb, Output& out) {
+    for (int axis : ALL_AXES) fb.set_abs(axis, 0);
+    out.flush(fb);
 }
 
 std::atomic<bool> running{true};
 
-void sigint_handler(int) { running = false; }
+// Every fd the daemon services lives in one epoll set. The registration tag
+// packs the source kind (high 32 bits) and an index (low 32 bits) so dispatch
+// is a switch on the kind with no per-event lookup.
+enum SourceKind : uint32_t { SRC_TP, SRC_KBD, SRC_SIGNAL, SRC_TIMER, SRC_STATS, SRC_HOTPLUG, SRC_OUTPUT, SRC_CONFIG, SRC_PASSTHROUGH };
+
+struct EventLoop {
+    int epfd = -1;
+
+    bool open() {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        return epfd >= 0;
+    }
+    bool add(int fd, uint32_t kind, uint32_t index = 0) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = (static_cast<uint64_t>(kind) << 32) | index;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl add");
+            return false;
+        }
+        return true;
+    }
+    void del(int fd) { epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr); }
+    int wait(epoll_event* out, int max, int timeout_ms) { return epoll_wait(epfd, out, max, timeout_ms); }
+    void close_all() { if (epfd >= 0) close(epfd); epfd = -1; }
+
+    static uint32_t kind_of(const epoll_event& ev) { return static_cast<uint32_t>(ev.data.u64 >> 32); }
+    static uint32_t index_of(const epoll_event& ev) { return static_cast<uint32_t>(ev.data.u64); }
+};
+
+// Blocks the given signals for normal delivery and returns a signalfd that
+// reports them instead, so shutdown is just another readable fd in the loop.
+int make_signalfd(std::initializer_list<int> sigs) {
+    sigset_t set;
+    sigemptyset(&set);
+    for (int s : sigs) sigaddset(&set, s);
+    if (sigprocmask(SIG_BLOCK, &set, nullptr) < 0) {
+        perror("sigprocmask");
+        return -1;
+    }
+    int fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) perror("signalfd");
+    return fd;
+}
+
+// Created disarmed: a timerfd that never fires costs nothing while idle.
+int make_timerfd() {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) perror("timerfd_create");
+    return fd;
+}
+
+// period_ns == 0 disarms.
+void set_timer(int fd, long period_ns) {
+    Stats::bump(g_stats.syscalls);
+    itimerspec its{};
+    its.it_value.tv_sec = period_ns / 1000000000L;
+    its.it_value.tv_nsec = period_ns % 1000000000L;
+    its.it_interval = its.it_value;
+    if (timerfd_settime(fd, 0, &its, nullptr) < 0) perror("timerfd_settime");
+}
+
+// Ticks on multiples of period_ns of CLOCK_MONOTONIC, so frames keep the same
+// phase however often the timer is stopped and re-armed.
+void set_timer_aligned(int fd, long period_ns) {
+    Stats::bump(g_stats.syscalls);
+    const int64_t next = (monotonic_ns() / period_ns + 1) * period_ns;
+    itimerspec its{};
+    its.it_value.tv_sec = next / 1000000000L;
+    its.it_value.tv_nsec = next % 1000000000L;
+    its.it_interval.tv_sec = period_ns / 1000000000L;
+    its.it_interval.tv_nsec = period_ns % 1000000000L;
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0) perror("timerfd_settime");
+}
+
+// Rewrites the given keys in an env file, keeping every other line, and
+// creates the file if needed. Replaced via rename so a daemon watching it
+// reloads a complete file.
+static bool update_env_file(const std::string& path, const std::vector<std::pair<std::string, std::string>>& kv) {
+    std::vector<std::string> lines;
+    std::vector<bool> done(kv.size(), false);
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            auto b = line.find_first_not_of(" \t");
+            auto eq = line.find('=');
+            for (size_t i = 0; b != std::string::npos && eq != std::string::npos && i < kv.size(); ++i) {
+                if (line.compare(b, eq - b, kv[i].first) != 0 || eq - b != kv[i].first.size()) continue;
+                line = kv[i].first + "=" + kv[i].second;
+                done[i] = true;
+            }
+            lines.push_back(line);
+        }
+    }
+    for (size_t i = 0; i < kv.size(); ++i) {
+        if (!done[i]) lines.push_back(kv[i].first + "=" + kv[i].second);
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::trunc);
+        for (const auto& l : lines) out << l << "\n";
+        out.flush();
+        if (!out) return false;
+    }
+    chmod(tmp.c_str(), 0644);
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// What identifies an input device across reboots: event numbers and even
+// by-id links can be reassigned, the ids, phys and name cannot. One open.
+static std::string device_identity(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return {};
+    std::string id;
+    libevdev* dev = nullptr;
+    if (libevdev_new_from_fd(fd, &dev) == 0 && dev) {
+        char ids[16];
+        std::snprintf(ids, sizeof(ids), "%04x:%04x", libevdev_get_id_vendor(dev) & 0xffff, libevdev_get_id_product(dev) & 0xffff);
+        const char* phys = libevdev_get_phys(dev);
+        const char* nm = libevdev_get_name(dev);
+        id = std::string(ids) + "|" + (phys ? phys : "") + "|" + (nm ? nm : "");
+        libevdev_free(dev);
+    }
+    close(fd);
+    return id;
+}
+
+// The last successful auto selection, tagged with the rules that made it.
+// On a match each auto device costs one open instead of a scan of every node.
+static std::string selection_rules(const Args& a, bool tp_auto, bool kbd_auto) {
+    std::string r = "tp=";
+    if (tp_auto) for (const auto& m : a.tp_matches) r += m + ",";
+    else r += "-";
+    r += ";kbd=";
+    if (kbd_auto) for (const auto& m : a.kbd_matches) r += m + ",";
+    else r += "-";
+    return r + ";" + a.on_missing;
+}
+
+// Fills the auto entries of tp/kbd only if every one of them still resolves
+// to the device it was saved for.
+static bool load_selection(const std::string& file, const std::string& rules, bool tp_auto, bool kbd_auto,
+                           std::string& tp, std::string& kbd) {
+    EnvMap env;
+    if (!read_env_file(file, env) || env["RULES"] != rules) return false;
+    for (const char* key : {"TP", "KBD"}) {
+        if (!(key[0] == 'T' ? tp_auto : kbd_auto)) continue;
+        const std::string& path = env[key];
+        const std::string want = env[std::string(key) + "_ID"];
+        if (path.empty() || want.empty() || device_identity(path) != want) return false;
+    }
+    if (tp_auto) tp = env["TP"];
+    if (kbd_auto) kbd = env["KBD"];
+    return true;
+}
 
-enum class Mode { ORBIT, TILT, PAN };
+static void save_selection(const std::string& file, const std::string& rules, const std::string& tp, const std::string& kbd) {
+    if (!update_env_file(file, {{"RULES", rules}, {"TP", tp}, {"TP_ID", device_identity(tp)},
+                                {"KBD", kbd}, {"KBD_ID", device_identity(kbd)}})) {
+        std::cerr << "[auto] could not save the selection to " << file << std::endl;
+    }
+}
 
-std::string mode_name(Mode m) {
-    switch (m) {
-        case Mode::TILT:
-            return "tilt";
-        case Mode::PAN:
-            return "pan";
-        default:
-            return "orbit";
+// Collects one max(|dx|, |dy|) per report (both components with per_axis)
+// for ms milliseconds.
+static void collect_reports(libevdev* dev, int ms, bool per_axis, std::vector<int>& out) {
+    DeviceInput in;
+    const int64_t end = monotonic_ns() + int64_t{ms} * 1000000;
+    pollfd p{libevdev_get_fd(dev), POLLIN, 0};
+    for (int64_t now = monotonic_ns(); now < end; now = monotonic_ns()) {
+        if (poll(&p, 1, static_cast<int>((end - now) / 1000000) + 1) <= 0) continue;
+        input_event ev;
+        ReportDelta rd;
+        int rc;
+        while ((rc = libevdev_next_event(dev, LIBEVDEV_READ_FLAG_NORMAL, &ev)) >= 0) {
+            if (rc == LIBEVDEV_READ_STATUS_SYNC) {
+                // ev is the SYN_DROPPED: drop the partial report. Reading on
+                // in normal mode makes libevdev discard its resync events.
+                in.feed(ev, rd);
+                continue;
+            }
+            if (!in.feed(ev, rd)) continue;
+            const int x = static_cast<int>(std::llabs(rd.dx) >> Q16), y = static_cast<int>(std::llabs(rd.dy) >> Q16);
+            if (per_axis) {
+                out.push_back(x);
+                out.push_back(y);
+            } else {
+                out.push_back(std::max(x, y));
+            }
+        }
     }
 }
 
+// --calibrate: measures the primary TP at rest and at full force and stores
+// the derived DEADZONE, GAIN and CURVE in the env file.
+static int run_calibration(const Args& args, const std::string& env_path) {
+    int fd = open(args.tp_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    libevdev* dev = nullptr;
+    if (fd < 0 || libevdev_new_from_fd(fd, &dev) < 0) {
+        std::cerr << "failed to open evdev " << args.tp_path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return EXIT_FAILURE;
+    }
+    // Keeps the pointer still while the stick is pushed around.
+    libevdev_grab(dev, LIBEVDEV_GRAB);
+    // A second after each prompt is read and discarded while the user reacts.
+    std::vector<int> rest, push, skip;
+    std::cout << "[calibrate] " << args.tp_path << ": hands off the TrackPoint..." << std::endl;
+    collect_reports(dev, 1000, false, skip);
+    collect_reports(dev, 3000, true, rest);
+    std::cout << "[calibrate] now push it as hard as you would for full speed, in every direction..." << std::endl;
+    collect_reports(dev, 1000, false, skip);
+    collect_reports(dev, 5000, false, push);
+    libevdev_grab(dev, LIBEVDEV_UNGRAB);
+    libevdev_free(dev);
+    close(fd);
+
+    Calibration cal;
+    std::string err;
+    if (!compute_calibration(rest, push, args.axis_range, cal, err)) {
+        std::cerr << "[calibrate] " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ostringstream gain, curve;
+    gain << std::setprecision(4) << cal.gain;
+    if (cal.exponent == 1.0) curve << "linear";
+    else curve << "power:" << cal.exponent;
+    std::cout << "[calibrate] rest noise " << cal.noise << ", full force " << cal.full << " counts (" << rest.size() / 2
+              << "/" << push.size() << " reports)\n"
+              << "[calibrate] DEADZONE=" << cal.deadzone << " GAIN=" << gain.str() << " CURVE=" << curve.str() << std::endl;
+    if (!update_env_file(env_path, {{"DEADZONE", std::to_string(cal.deadzone)}, {"GAIN", gain.str()}, {"CURVE", curve.str()}})) {
+        std::cerr << "failed to write env file: " << env_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "[calibrate] saved to " << env_path << std::endl;
+    return 0;
+}
+
+// An input device a seat reads from. A read error other than -EAGAIN
+// (typically -ENODEV on unplug) detaches it while the output stays up; the
+// hotplug watch then reopens the same path once a device with the same name
+// shows up there again. TPs carry their index (epoll tag, record source) and
+// report state.
+struct Attached {
+    std::string path;
+    SourceKind kind = SRC_TP;
+    uint32_t index = 0;
+    std::string name;
+    libevdev* dev = nullptr;
+    DeviceInput in;
+};
+
+// Read-write for a keyboard whose LEDs we drive (--kbd-grab).
+libevdev* try_open_evdev(const std::string& path, int mode = O_RDONLY) {
+    int fd = open(path.c_str(), mode | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    // Monotonic event timestamps: comparable with our own clock for
+    // latency stats and immune to wall-clock steps in the filter.
+    int clk = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clk);
+    libevdev* dev = nullptr;
+    if (libevdev_new_from_fd(fd, &dev) < 0) {
+        close(fd);
+        return nullptr;
+    }
+    return dev;
+}
+
+void close_evdev(libevdev* dev) {
+    int fd = libevdev_get_fd(dev);
+    libevdev_free(dev);
+    close(fd);
+}
+
+void record_latency(int64_t ev_us) {
+    if (g_stats.enabled) g_stats.latency_ns.record(static_cast<uint64_t>(std::max<int64_t>(0, monotonic_ns() - ev_us * 1000)));
+}
+
+// What a seat derives from its options. Built and validated as a whole, at
+// startup and on every reload, so a bad value never replaces a working one.
+struct SeatConfig {
+    AbsConfig abs;
+    DeviceIdentity ident;
+    ModeTable modes;
+    ChordTable chords;
+    CurveSet curves;
+    CurveSet precise_curves;  // the same at --precision times the gain
+    MotionFilter filter;
+    int64_t lock_q16 = 0;
+    int64_t release_q16 = 0;
+    std::vector<DeviceMap> maps;  // per TP, primary first
+    int wheel_axis = -1;
+    int wheel_units = 0;
+};
+
+// Also normalises a: --decay-ms implies --rate 250, --output is lowercased.
+static bool build_seat_config(Args& a, SeatConfig& c, std::string& err) {
+    auto fail = [&](const std::string& msg) { err = msg; return false; };
+    if (a.rate_hz < 0 || a.rate_hz > 2000) return fail("--rate must be between 0 and 2000 Hz");
+    if (a.decay_ms < 0) return fail("--decay-ms must be non-negative (0 = off)");
+    if (a.decay_ms > 0 && a.rate_hz == 0) a.rate_hz = 250;
+    if (a.predict_ms < 0 || a.predict_ms > 50) return fail("--predict-ms must be between 0 and 50");
+    if (a.predict_ms > 0 && a.rate_hz == 0) return fail("--predict-ms requires --rate");
+    if (a.deadzone < 0 || a.deadzone > 100) return fail("--deadzone must be between 0 and 100");
+    if (a.hotkey < 0 || a.hotkey > KEY_MAX) return fail("--hotkey must be an EV_KEY code");
+    if (a.axis_range < 1 || a.axis_range > 32767) return fail("--axis-range must be between 1 and 32767");
+    for (auto& ch : a.output) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    if (a.output != "uinput" && a.output != "spnav") return fail("--output must be uinput or spnav");
+    c = SeatConfig{};
+    c.abs.range = a.axis_range;
+    if (!parse_axis_values(a.abs_fuzz, c.abs.fuzz, err)) return fail("--abs-fuzz: " + err);
+    if (!parse_axis_values(a.abs_flat, c.abs.flat, err)) return fail("--abs-flat: " + err);
+    if (!parse_axis_values(a.abs_res, c.abs.resolution, err)) return fail("--abs-res: " + err);
+    c.ident.name = a.uinput_name;
+    if (c.ident.name.empty() || c.ident.name.size() >= UINPUT_MAX_NAME_SIZE) return fail("--uinput-name must be 1-79 characters");
+    if (!parse_uinput_id(a.uinput_id, c.ident)) return fail("--uinput-id must be <vendor>:<product> in hex, e.g. 046d:c603");
+    if (!build_modes(a.modes, c.modes, err)) return fail("--mode: " + err);
+    if (!build_chords(a.chords, a.hotkey, c.modes, c.chords, err)) return fail("--chord: " + err);
+    if (!build_curves(a.curves, a.gain, c.modes, c.curves, err)) return fail("--curve: " + err);
+    if (!(a.precision > 0 && a.precision <= 1)) return fail("--precision must be in (0, 1]");
+    if (!build_curves(a.curves, a.gain * a.precision, c.modes, c.precise_curves, err)) return fail("--precision: " + err);
+    if (!parse_axis_lock_spec(a.axis_lock, c.lock_q16, c.release_q16, err)) return fail("--axis-lock: " + err);
+    if (!parse_filter_spec(a.filter, c.filter, err)) return fail("--filter: " + err);
+    if (!parse_wheel_spec(a.wheel, c.wheel_axis, c.wheel_units, err)) return fail("--wheel: " + err);
+    c.maps.resize(1 + a.tp_extra.size());
+    for (size_t i = 0; i < c.maps.size(); ++i) {
+        if (!parse_device_map(i == 0 ? a.tp_map : a.tp_extra[i - 1].map, c.maps[i], err)) return fail("--tp: " + err);
+    }
+    return true;
+}
+
+// What every seat shares: the epoll set and the --record file.
+struct Shared {
+    EventLoop loop;
+    FILE* rec = nullptr;
+};
+
+// One (TPs, KBD, output) pipeline. A plain run has a single seat; --seat runs
+// one per file, all served by the same event loop. Seat tags put the seat in
+// the upper 16 bits of the epoll index and the device below.
+struct Seat {
+    uint32_t id = 0;
+    std::string tag;  // "" or "[<name>] ", prefixed to log lines
+    const char* prog = "";
+    Args args;
+    std::vector<std::string> overrides;  // options applied over the file on reload
+    EnvMap loaded_env;
+    bool owns_log_level = false;
+    SeatConfig cfg;
+    Shared* sh = nullptr;
+
+    std::unique_ptr<Output> out;
+    FrameBuilder frame;
+    std::vector<Attached> tps;
+    Attached kbd;
+    std::unique_ptr<KeyPassthrough> pass;  // --kbd-grab
+    bool kbd_grabbed = false;
+    int tfd = -1;
+    int config_fd = -1;
+    std::string config_name;
+    KeyState keys;
+    ChordEngine chord;
+    OutputStage stage;
+    MotionPipeline pipeline;
+    bool timed_output = false;
+    long tick_ns = 0;
+    bool timer_armed = false;
+    // Kernel timestamp of the oldest report latched but not yet published.
+    int64_t pending_us = 0;
+
+    static uint32_t tag_of(uint32_t seat, uint32_t dev) { return seat << 16 | dev; }
+
+    std::vector<Attached*> inputs() {
+        std::vector<Attached*> v{&kbd};
+        for (auto& t : tps) v.push_back(&t);
+        return v;
+    }
+
+    // Creates the output, opens the devices and registers them with the
+    // loop; false (reported) aborts startup.
+    bool open() {
+        if (args.output == "spnav") {
+            auto spnav = std::make_unique<SpnavOutput>();
+            if (!spnav->open(args.spnav_socket)) return false;
+            out = std::move(spnav);
+        } else {
+            out = std::make_unique<UinputOutput>(setup_uinput(cfg.abs, cfg.ident));
+        }
+        tps.resize(1 + args.tp_extra.size());
+        assert(cfg.maps.size() == tps.size());
+        for (uint32_t i = 0; i < tps.size(); ++i) {
+            tps[i].path = i == 0 ? args.tp_path : args.tp_extra[i - 1].path;
+            tps[i].index = i;
+            tps[i].in.map = cfg.maps[i];
+        }
+        kbd.path = args.kbd_path;
+        kbd.kind = SRC_KBD;
+        for (Attached* a : inputs()) {
+            a->dev = try_open_evdev(a->path, a->kind == SRC_KBD && args.kbd_grab ? O_RDWR : O_RDONLY);
+            if (!a->dev) {
+                std::cerr << "failed to open evdev " << a->path << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            const char* nm = libevdev_get_name(a->dev);
+            a->name = nm ? nm : "";
+        }
+        tfd = make_timerfd();
+        // Editors replace the env file by rename, so the directory is watched.
+        if (!args.config_path.empty()) {
+            namespace fs = std::filesystem;
+            config_name = fs::path(args.config_path).filename().string();
+            config_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            std::string dir = fs::path(args.config_path).parent_path().string();
+            if (config_fd >= 0 && inotify_add_watch(config_fd, dir.empty() ? "." : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+                perror("inotify_add_watch --config");
+            }
+        }
+        for (const auto& t : tps) {
+            if (!sh->loop.add(libevdev_get_fd(t.dev), SRC_TP, tag_of(id, t.index))) return false;
+        }
+        if (args.kbd_grab) {
+            pass = std::make_unique<KeyPassthrough>(setup_uinput_keyboard(kbd.dev));
+            if (!sh->loop.add(pass->fd, SRC_PASSTHROUGH, tag_of(id, 0))) return false;
+            grab_kbd();
+        }
+        if (!sh->loop.add(libevdev_get_fd(kbd.dev), SRC_KBD, tag_of(id, 0)) ||
+            (out->poll_fd() >= 0 && !sh->loop.add(out->poll_fd(), SRC_OUTPUT, tag_of(id, 0))) ||
+            (config_fd >= 0 && !sh->loop.add(config_fd, SRC_CONFIG, tag_of(id, 0))) ||
+            (tfd >= 0 && !sh->loop.add(tfd, SRC_TIMER, tag_of(id, 0)))) {
+            return false;
+        }
+        timed_output = args.rate_hz > 0 && tfd >= 0;
+        tick_ns = timed_output ? 1000000000L / args.rate_hz : 0;
+        stage.configure(args.rate_hz, args.decay_ms, args.predict_ms);
+        stage.axis_max = cfg.abs.range;
+        pipeline.curves = &cfg.curves;
+        pipeline.modes = &cfg.modes;
+        chord.table = &cfg.chords;
+        chord.modes = &cfg.modes;
+        chord.resolve(keys);
+        pipeline.filter = cfg.filter;
+        pipeline.axis_max = cfg.abs.range;
+        pipeline.deadzone = args.deadzone;
+        pipeline.wheel_axis = cfg.wheel_axis;
+        pipeline.wheel_units = cfg.wheel_units;
+        pipeline.lock_q16 = cfg.lock_q16;
+        pipeline.release_q16 = cfg.release_q16;
+        return true;
+    }
+
+    void close_all() {
+        for (auto& t : tps) if (t.dev) libevdev_grab(t.dev, LIBEVDEV_UNGRAB);
+        pass.reset();
+        if (kbd_grabbed && kbd.dev) libevdev_grab(kbd.dev, LIBEVDEV_UNGRAB);
+        if (out) zero_all_axes(frame, *out);
+        out.reset();
+        if (tfd >= 0) close(tfd);
+        if (config_fd >= 0) close(config_fd);
+        for (Attached* a : inputs()) {
+            if (a->dev) close_evdev(a->dev);
+            a->dev = nullptr;
+        }
+    }
+
+    void stop_output() {
+        stage.reset();
+        pending_us = 0;
+        if (timer_armed) { set_timer(tfd, 0); timer_armed = false; }
+        zero_all_axes(frame, *out);
+    }
+    void reset_motion() {
+        for (auto& t : tps) t.in.reset();
+        pipeline.reset();
+    }
+
+    // --kbd-grab: grabbing while a key is down would leave it stuck in the
+    // app that saw the press (Enter of the shell that started us), so the
+    // grab waits until the keyboard is idle.
+    void grab_kbd() {
+        if (!pass || kbd_grabbed || !kbd.dev) return;
+        for (int code = 0; code <= KEY_MAX; ++code) {
+            if (libevdev_get_event_value(kbd.dev, EV_KEY, code)) return;
+        }
+        if (libevdev_grab(kbd.dev, LIBEVDEV_GRAB) < 0) {
+            log_msg(LogLevel::ERROR, "%s[kbd-grab] cannot grab %s; keys are not filtered", tag.c_str(), kbd.path.c_str());
+            return;
+        }
+        kbd_grabbed = true;
+    }
+    // Chord keys stay ours; the toggle always, the rest (and the mode
+    // modifiers) while capture is on. Everything else reaches the app.
+    bool swallow_key(int code) const {
+        const uint8_t action = cfg.chords.key[code].action;
+        if (action == CHORD_TOGGLE) return true;
+        if (!(keys.load() & KeyState::GRABBED)) return false;
+        return action != CHORD_NONE || KeyState::is_modifier(code);
+    }
+    void pass_event(const input_event& ev) {
+        if (!kbd_grabbed) return;
+        if (ev.type == EV_KEY) pass->key(ev, swallow_key(ev.code));
+        else if (ev.type == EV_SYN && ev.code == SYN_REPORT) pass->sync();
+    }
+    void flush_passthrough() {
+        const int64_t t_us = pass->first_us;
+        if (pass->flush() > 0 && t_us && g_stats.enabled) {
+            g_stats.passthrough_ns.record(static_cast<uint64_t>(std::max<int64_t>(0, monotonic_ns() - t_us * 1000)));
+        }
+    }
+    // LED changes the host makes on the virtual keyboard go to the real one.
+    void on_passthrough_readable() {
+        input_event evs[16];
+        ssize_t len;
+        while ((len = read(pass->fd, evs, sizeof(evs))) > 0) {
+            for (ssize_t i = 0; i < len / static_cast<ssize_t>(sizeof(input_event)); ++i) {
+                if (evs[i].type != EV_LED || !kbd.dev) continue;
+                libevdev_kernel_set_led_value(kbd.dev, evs[i].code, evs[i].value ? LIBEVDEV_LED_ON : LIBEVDEV_LED_OFF);
+            }
+        }
+    }
+
+    void on_key(const input_event& ev) {
+        if (pass) pass_event(ev);
+        keys.set(ev.code, ev.value != 0);
+
+        if (chord.on_key(ev.code, ev.value, event_time_us(ev), keys)) {
+            if (keys.load() & KeyState::GRABBED) {
+                for (auto& t : tps) if (t.dev) libevdev_grab(t.dev, LIBEVDEV_UNGRAB);
+                keys.set_flag(KeyState::GRABBED, false);
+                reset_motion();
+                stop_output();
+                log_msg(LogLevel::INFO, "%s[toggle] OFF", tag.c_str());
+            } else {
+                for (auto& t : tps) if (t.dev) libevdev_grab(t.dev, LIBEVDEV_GRAB);
+                keys.set_flag(KeyState::GRABBED, true);
+                log_msg(LogLevel::INFO, "%s[toggle] ON", tag.c_str());
+            }
+        }
+    }
+
+    // Publishes the reports all TPs delivered during one wakeup as a single
+    // frame, timed from the oldest of them.
+    void emit_motion() {
+        const int64_t t_us = pipeline.first_us;
+        MotionFrame mf;
+        pipeline.curves = chord.precise ? &cfg.precise_curves : &cfg.curves;
+        if (!pipeline.flush(chord.mode, mf)) return;
+        if (mf.mode_changed) {
+            // The old mode's axes return to zero in the same report that sets
+            // the new ones: a paced stage writes every axis on its next tick.
+            if (timed_output) stage.reset();
+            else for (int axis : ALL_AXES) frame.set_abs(axis, 0);
+            log_msg(LogLevel::INFO, "%s[mode]: %s", tag.c_str(), cfg.modes.def[mf.mode].name);
+        }
+
+        auto publish = [&](int axis, int v) {
+            if (timed_output) stage.set(axis, v);
+            else frame.set_abs(axis, v);
+        };
+        // A wheel pulse is a one-off excursion on its axis, not a position.
+        const int held = mf.pulse ? mf.n - 1 : mf.n;
+        for (int i = 0; i < held; ++i) publish(mf.axis[i], mf.value[i]);
+        if (mf.pulse && timed_output) stage.pulse(mf.axis[held], mf.value[held]);
+        else if (mf.pulse) frame.set_abs(mf.axis[held], mf.value[held]);
+        if (!timed_output) {
+            if (out->flush(frame) > 0) record_latency(t_us);
+            if (mf.pulse) {
+                frame.set_abs(mf.axis[held], 0);
+                out->flush(frame);
+            }
+            return;
+        }
+        if (pending_us == 0) pending_us = t_us;
+        if (!timer_armed) {
+            set_timer_aligned(tfd, tick_ns);
+            timer_armed = true;
+        }
+    }
+
+    void on_timer() {
+        uint64_t expirations;
+        while (read(tfd, &expirations, sizeof(expirations)) > 0) {}
+        if (!timer_armed) return;
+        bool active = stage.tick(frame);
+        if (out->flush(frame) > 0 && pending_us != 0) record_latency(pending_us);
+        pending_us = 0;
+        if (!active) { set_timer(tfd, 0); timer_armed = false; }
+    }
+
+    void detach(Attached& a, int err) {
+        log_msg(LogLevel::WARN, "%s[hotplug] lost %s %s (%s); waiting for it to return",
+                tag.c_str(), a.kind == SRC_TP ? "TP" : "KBD", a.path.c_str(), std::strerror(-err));
+        sh->loop.del(libevdev_get_fd(a.dev));
+        close_evdev(a.dev);
+        a.dev = nullptr;
+        if (a.kind == SRC_TP) {
+            reset_motion();
+            stop_output();
+        } else {
+            // Releases arrive on the device that is gone; do not leave a
+            // modifier stuck down, here or in the app.
+            keys.release_all();
+            chord.resolve(keys);
+            if (pass) {
+                pass->release_all();
+                flush_passthrough();
+                kbd_grabbed = false;
+            }
+        }
+    }
+
+    void reattach(Attached& a) {
+        libevdev* dev = try_open_evdev(a.path, a.kind == SRC_KBD && args.kbd_grab ? O_RDWR : O_RDONLY);
+        if (!dev) return;
+        const char* nm = libevdev_get_name(dev);
+        if (a.name != (nm ? nm : "") || !sh->loop.add(libevdev_get_fd(dev), a.kind, tag_of(id, a.index))) {
+            close_evdev(dev);
+            return;
+        }
+        a.dev = dev;
+        if (a.kind == SRC_TP && (keys.load() & KeyState::GRABBED)) libevdev_grab(a.dev, LIBEVDEV_GRAB);
+        if (a.kind == SRC_KBD) grab_kbd();
+        log_msg(LogLevel::INFO, "%s[hotplug] reattached %s %s", tag.c_str(), a.kind == SRC_TP ? "TP" : "KBD", a.path.c_str());
+    }
+    void reattach_missing() {
+        for (Attached* a : inputs()) if (!a->dev) reattach(*a);
+    }
+
+    void record_event(const Attached& a, const input_event& ev) {
+        const uint8_t src = a.kind == SRC_KBD ? uint8_t{REC_KBD} : a.index == 0 ? uint8_t{REC_TP} : static_cast<uint8_t>(REC_TP_EXTRA + a.index - 1);
+        RecordEntry e{event_time_us(ev), src, static_cast<uint8_t>(ev.type), ev.code, ev.value};
+        std::fwrite(&e, sizeof(e), 1, sh->rec);
+    }
+
+    // Level-triggered: drain each device until -EAGAIN so one wakeup handles
+    // the whole burst the kernel queued.
+    void drain(Attached& a) {
+        const bool is_tp = a.kind == SRC_TP;
+        input_event ev;
+        int rc;
+        while ((rc = libevdev_next_event(a.dev, LIBEVDEV_READ_FLAG_NORMAL, &ev)) >= 0) {
+            Stats::bump(g_stats.events_in);
+            if (sh->rec) record_event(a, ev);
+            if (rc == LIBEVDEV_READ_STATUS_SYNC) {
+                // The kernel buffer overflowed (ev is the SYN_DROPPED). The TP
+                // drops its partial report; for the keyboard, libevdev replays
+                // the key changes we missed so no modifier stays stuck.
+                Stats::bump(g_stats.syn_dropped);
+                log_msg(LogLevel::DEBUG, "%s[evdev] SYN_DROPPED on %s; resyncing", tag.c_str(), a.path.c_str());
+                ReportDelta rd;
+                if (is_tp) a.in.feed(ev, rd);
+                while ((rc = libevdev_next_event(a.dev, LIBEVDEV_READ_FLAG_SYNC, &ev)) == LIBEVDEV_READ_STATUS_SYNC) {
+                    if (sh->rec) record_event(a, ev);
+                    if (is_tp) continue;
+                    if (pass) pass_event(ev);
+                    if (ev.type == EV_KEY) keys.set(ev.code, ev.value != 0);
+                }
+                if (!is_tp) chord.resolve(keys);
+                if (rc < 0 && rc != -EAGAIN) break;
+                continue;
+            }
+            if (is_tp) {
+                if (!(keys.load() & KeyState::GRABBED)) continue;
+                ReportDelta rd;
+                if (a.in.feed(ev, rd)) pipeline.add(rd, event_time_us(ev));
+            } else if (ev.type == EV_KEY) {
+                on_key(ev);
+            } else if (pass) {
+                pass_event(ev);
+            }
+        }
+        if (rc != -EAGAIN) {
+            detach(a, rc);
+        } else if (!is_tp && pass) {
+            // One write for everything this wakeup passes through.
+            flush_passthrough();
+            grab_kbd();
+        }
+    }
+
+    void on_config_readable() {
+        alignas(inotify_event) char buf[4096];
+        bool changed = false;
+        ssize_t len;
+        while ((len = read(config_fd, buf, sizeof(buf))) > 0) {
+            for (char* q = buf; q < buf + len; q += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(q)->len) {
+                const auto* ev = reinterpret_cast<const inotify_event*>(q);
+                if (ev->len && config_name == ev->name) changed = true;
+            }
+        }
+        if (changed) reload();
+    }
+
+    // Re-reads the config file. Everything is parsed and validated before
+    // anything is replaced, and the swap happens between loop iterations, so
+    // no frame mixes old and new settings; the output device is left alone.
+    void reload() {
+        if (args.config_path.empty()) {
+            log_msg(LogLevel::WARN, "[config] no --config file; SIGHUP ignored");
+            return;
+        }
+        EnvMap env;
+        Args next;
+        SeatConfig next_cfg;
+        std::string err;
+        if (!read_env_file(args.config_path, env)) {
+            err = std::string("cannot read ") + args.config_path + ": " + std::strerror(errno);
+        } else {
+            try {
+                auto av = env_to_args(env);
+                av.insert(av.end(), overrides.begin(), overrides.end());
+                next = parse_args(av, prog);
+            } catch (const std::exception&) {
+                err = "bad number";
+            }
+        }
+        if (err.empty()) build_seat_config(next, next_cfg, err);
+        LogLevel next_log_level = LogLevel::INFO;
+        if (err.empty() && owns_log_level && !parse_log_level(next.log_level, next_log_level)) {
+            err = "--log-level must be error, warn, info or debug";
+        }
+        if (!err.empty()) {
+            log_msg(LogLevel::ERROR, "%s[config] %s; keeping the current settings", tag.c_str(), err.c_str());
+            return;
+        }
+        for (const char* key : ENV_RESTART_ONLY) {
+            if (env[key] != loaded_env[key]) log_msg(LogLevel::WARN, "%s[config] %s changed; restart to apply it", tag.c_str(), key);
+        }
+        // The mapping may have moved axes; start from a centred puck.
+        reset_motion();
+        stop_output();
+        cfg.modes = next_cfg.modes;
+        cfg.chords = next_cfg.chords;
+        cfg.curves = next_cfg.curves;
+        cfg.precise_curves = next_cfg.precise_curves;
+        pipeline.lock_q16 = next_cfg.lock_q16;
+        pipeline.release_q16 = next_cfg.release_q16;
+        // Bindings may point at other modes now.
+        chord.reset();
+        chord.resolve(keys);
+        pipeline.filter = next_cfg.filter;
+        pipeline.wheel_axis = next_cfg.wheel_axis;
+        pipeline.wheel_units = next_cfg.wheel_units;
+        pipeline.deadzone = next.deadzone;
+        if (owns_log_level) set_log_level(next_log_level);
+        if (timed_output) stage.configure(args.rate_hz, next.decay_ms, next.predict_ms);
+        else if (next.decay_ms > 0 || next.predict_ms > 0) log_msg(LogLevel::WARN, "%s[config] decay/predict need a rate; restart to apply", tag.c_str());
+        args.gain = next.gain;
+        args.deadzone = next.deadzone;
+        args.curves = next.curves;
+        args.modes = next.modes;
+        args.chords = next.chords;
+        args.axis_lock = next.axis_lock;
+        args.precision = next.precision;
+        args.filter = next.filter;
+        args.wheel = next.wheel;
+        args.log_level = next.log_level;
+        args.hotkey = next.hotkey;
+        args.decay_ms = next.decay_ms;
+        args.predict_ms = next.predict_ms;
+        log_msg(LogLevel::INFO, "%s[config] reloaded %s", tag.c_str(), args.config_path.c_str());
+    }
+};
+
 std::string read_self_path() {
     char buf[PATH_MAX];
     ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
@@ -273,8 +1543,9 @@ std::string read_self_path() {
 
 int main(int argc, char** argv) {
     namespace fs = std::filesystem;
-    g_show_install = !is_installed_copy(DEFAULT_SERVICE_NAME);
-    Args args = parse_args(argc, argv);
+    const std::vector<std::string> cli(argv + 1, argv + argc);
+    EnvMap loaded_env;
+    Args args = load_args(cli, argv[0], loaded_env);
 
     auto to_lower = [](std::string s){
         for (auto &c : s) c = static_cast<char>(::tolower(static_cast<unsigned char>(c)));
@@ -304,13 +1575,27 @@ int main(int argc, char** argv) {
         for (int i = 1; i < argc; ++i) if (std::strcmp(argv[i], opt) == 0) return true; return false;
     };
     if (args.list_devices) {
-        const char* conflicts[] = {"--install","--tp","--kbd","--gain","--hotkey","--auto",
-                                   "--tp-match","--kbd-match","--on-missing","--wait-secs",
+        const char* conflicts[] = {"--install","--calibrate","--tp","--kbd","--gain","--deadzone","--hotkey","--curve","--mode","--chord","--precision","--axis-lock","--filter","--rate","--decay-ms","--predict-ms","--wheel","--axis-range","--abs-fuzz","--abs-flat","--abs-res","--output","--spnav-socket","--stats","--stats-interval","--log-level","--record",
+                                   "--rt-priority","--rt-policy","--cpu","--mlock","--nice","--auto","--kbd-grab",
+                                   "--uinput-name","--uinput-id","--seat","--tp-match","--tp-all","--kbd-match","--selection-cache","--config","--on-missing","--wait-secs",
                                    "--install-path","--service-name","--env-dir"};
         for (const char* c : conflicts) if (argv_has(c)) error_and_usage("--list-devices cannot be combined with other flags");
     }
-    if (!args.install && (argv_has("--install-path") || argv_has("--service-name") || argv_has("--env-dir"))) {
-        error_and_usage("--install-path/--service-name/--env-dir require --install");
+    if (!args.seats.empty()) {
+        // Each file is a complete seat; only process-wide settings may come
+        // from the command line.
+        const char* conflicts[] = {"--install","--calibrate","--tp","--kbd","--gain","--deadzone","--hotkey","--curve","--mode","--chord","--precision","--axis-lock","--filter","--rate","--decay-ms","--predict-ms","--wheel","--axis-range","--abs-fuzz","--abs-flat","--abs-res","--output","--spnav-socket",
+                                   "--uinput-name","--uinput-id","--record","--auto","--tp-match","--tp-all","--kbd-match","--kbd-grab","--selection-cache","--config","--on-missing","--wait-secs"};
+        for (const char* c : conflicts) if (argv_has(c)) error_and_usage(std::string("--seat cannot be combined with ") + c);
+    }
+    if (!args.install && (argv_has("--install-path") || argv_has("--service-name"))) {
+        error_and_usage("--install-path/--service-name require --install");
+    }
+    if (!args.install && !args.calibrate && argv_has("--env-dir")) {
+        error_and_usage("--env-dir requires --install or --calibrate");
+    }
+    if (args.install && args.calibrate) {
+        error_and_usage("--calibrate cannot be combined with --install; calibrate after installing");
     }
     if (argv_has("--wait-secs") && policy != MissingPolicy::WAIT) {
         error_and_usage("--wait-secs is only valid with --on-missing=wait");
@@ -331,23 +1616,58 @@ int main(int argc, char** argv) {
     if (!args.tp_matches.empty() && !tp_auto_engaged()) {
         error_and_usage("--tp-match requires TP auto selection (use --auto or --tp auto)");
     }
+    if (args.tp_all && (!tp_auto_engaged() || args.tp_matches.empty())) {
+        error_and_usage("--tp-all requires TP auto selection and at least one --tp-match");
+    }
+    for (const auto& t : args.tp_extra) {
+        if (equals_ci(t.path, "auto")) error_and_usage("--tp auto is only valid for the first TP");
+    }
     if (!args.kbd_matches.empty() && !kbd_auto_engaged()) {
         error_and_usage("--kbd-match requires KBD auto selection (use --auto or --kbd auto)");
     }
-
-
-    auto contains_ci = [&](const std::string& hay, const std::string& needle){
-        auto h = to_lower(hay);
-        auto n = to_lower(needle);
-        return h.find(n) != std::string::npos;
-    };
+    if (argv_has("--stats-interval") && !args.stats) {
+        error_and_usage("--stats-interval requires --stats");
+    }
+    if (args.stats_interval < 0) {
+        error_and_usage("--stats-interval must be non-negative (0 = SIGUSR1 only)");
+    }
+    args.rt_policy = to_lower(args.rt_policy);
+    if (args.rt_priority < 0 || args.rt_priority > 99) {
+        error_and_usage("--rt-priority must be between 1 and 99");
+    }
+    if (args.rt_policy != "fifo" && args.rt_policy != "rr") {
+        error_and_usage("--rt-policy must be fifo or rr");
+    }
+    if (argv_has("--rt-policy") && args.rt_priority == 0) {
+        error_and_usage("--rt-policy requires --rt-priority");
+    }
+    if (args.nice < -20 || args.nice > 19) {
+        error_and_usage("--nice must be between -20 and 19");
+    }
+    {
+        std::vector<int> cpus;
+        if (!args.cpus.empty() && !parse_cpu_list(args.cpus, cpus)) error_and_usage("--cpu: bad CPU list '" + args.cpus + "'");
+    }
+    SeatConfig cfg;
+    if (args.seats.empty()) {
+        std::string err;
+        if (!build_seat_config(args, cfg, err)) error_and_usage(err);
+    }
+    if (argv_has("--spnav-socket") && args.output != "spnav") {
+        error_and_usage("--spnav-socket requires --output spnav");
+    }
+    {
+        LogLevel level;
+        if (!parse_log_level(args.log_level, level)) error_and_usage("--log-level must be error, warn, info or debug");
+        set_log_level(level);
+    }
 
     auto inotify_fd = [&](){
         int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
         if (fd < 0) return -1;
         auto add = [&](const char* d){
             std::error_code ec; if (std::filesystem::exists(d, ec)) {
-                inotify_add_watch(fd, d, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+                inotify_add_watch(fd, d, IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO);
             }
         };
         add("/dev/input");
@@ -355,34 +1675,13 @@ int main(int argc, char** argv) {
         add("/dev/input/by-path");
         return fd;
     };
-    auto wait_change_or_timeout = [&](int fd, int ms){
-        if (fd < 0) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); return false; }
-        pollfd p{}; p.fd = fd; p.events = POLLIN;
-        int rc = poll(&p, 1, ms);
-        if (rc > 0 && (p.revents & POLLIN)) {
-            char buf[4096];
-            while (read(fd, buf, sizeof(buf)) > 0) {}
-            return true;
-        }
-        return false;
-    };
 
-    struct Candidate { std::string path; std::string base; std::string origin; std::string name; bool has_rel_xy; bool has_keys; };
+    ProbeCache probes;
     auto evdev_caps = [&](const std::string& path, std::string& name_out, bool& relxy_out, bool& keys_out){
-        relxy_out = false; keys_out = false; name_out.clear();
-        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-        if (fd < 0) return;
-        libevdev* dev = nullptr;
-        if (libevdev_new_from_fd(fd, &dev) == 0 && dev) {
-            const char* nm = libevdev_get_name(dev);
-            if (nm) name_out = nm;
-            if (libevdev_has_event_type(dev, EV_REL)) {
-                if (libevdev_has_event_code(dev, EV_REL, REL_X) && libevdev_has_event_code(dev, EV_REL, REL_Y)) relxy_out = true;
-            }
-            if (libevdev_has_event_type(dev, EV_KEY)) keys_out = true;
-            libevdev_free(dev);
-        }
-        close(fd);
+        const Probe& p = probes.get(path);
+        name_out = p.name;
+        relxy_out = p.has_rel_xy;
+        keys_out = p.has_keys;
     };
     auto scan_symlinks = [&](const std::string& dir, const std::string& origin){
         std::vector<Candidate> v;
@@ -393,55 +1692,16 @@ int main(int argc, char** argv) {
             if (!de.is_symlink(ec)) continue;
             auto base = de.path().filename().string();
             if (base.find("event-") == std::string::npos) continue;
-            Candidate c{de.path().string(), base, origin, std::string(), false, false};
-            std::string nm; bool relxy=false, keys=false;
-            evdev_caps(c.path, nm, relxy, keys);
-            c.name = nm; c.has_rel_xy = relxy; c.has_keys = keys;
-            v.push_back(c);
+            v.push_back(Candidate{de.path().string(), base, origin, std::string(), false, false});
         }
+        std::vector<std::string> paths;
+        for (const auto& c : v) paths.push_back(c.path);
+        probes.prefetch(paths);
+        for (auto& c : v) evdev_caps(c.path, c.name, c.has_rel_xy, c.has_keys);
         std::sort(v.begin(), v.end(), [](const Candidate& a, const Candidate& b){ return a.base < b.base; });
         return v;
     };
 
-    auto choose_ordered = [&](const std::vector<Candidate>& pool,
-                              bool want_mouse,
-                              const std::vector<std::string>& rules,
-                              std::string& reason){
-        std::vector<const Candidate*> typed;
-        const std::string suffix = want_mouse ? std::string("-event-mouse") : std::string("-event-kbd");
-        for (const auto& c : pool) {
-            if (c.base.size() < suffix.size()) continue;
-            if (c.base.compare(c.base.size()-suffix.size(), suffix.size(), suffix) != 0) continue;
-            if (want_mouse && !c.has_rel_xy) continue;
-            if (!want_mouse && !c.has_keys) continue;
-            typed.push_back(&c);
-        }
-        if (typed.empty()) return std::string{};
-        int rix = 0;
-        for (const auto& r : rules) {
-            ++rix; if (r.empty()) continue;
-            for (const auto* pc : typed) {
-                if (contains_ci(pc->base, r) || (!pc->name.empty() && contains_ci(pc->name, r))) {
-                    reason = std::string("rule ") + std::to_string(rix) + std::string(" ('") + r + std::string("')");
-                    return pc->path;
-                }
-            }
-        }
-        static const std::vector<std::string> tp_kws = {"trackpoint","thinkpad","lenovo","trackpad","touchpad","logitech","mouse"};
-        static const std::vector<std::string> kb_kws = {"keyboard","kbd","thinkpad","lenovo","logitech"};
-        const auto& kws = want_mouse ? tp_kws : kb_kws;
-        for (const auto& kw : kws) {
-            for (const auto* pc : typed) {
-                if (contains_ci(pc->base, kw) || (!pc->name.empty() && contains_ci(pc->name, kw))) {
-                    reason = std::string("keyword '") + kw + std::string("'");
-                    return pc->path;
-                }
-            }
-        }
-        reason = "first capable in order";
-        return typed.front()->path;
-    };
-
     auto print_candidates = [&](const std::string& label, const std::vector<Candidate>& v){
         std::cout << "[scan] " << label << ": " << v.size() << " candidates" << std::endl;
         for (size_t i = 0; i < v.size(); ++i) {
@@ -452,45 +1712,15 @@ int main(int argc, char** argv) {
         }
     };
 
-    auto autodetect = [&](std::string& tp_out, std::string& kbd_out){
-        auto id = scan_symlinks("/dev/input/by-id", "by-id");
-        auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
-        print_candidates("/dev/input/by-id", id);
-        print_candidates("/dev/input/by-path", ppath);
-        auto choose_rules_only = [&](const std::vector<Candidate>& pool, bool want_mouse, const std::vector<std::string>& rules, std::string& reason){
-            std::vector<const Candidate*> typed;
-            const std::string suffix = want_mouse ? std::string("-event-mouse") : std::string("-event-kbd");
-            for (const auto& c : pool) {
-                if (c.base.size() < suffix.size()) continue;
-                if (c.base.compare(c.base.size()-suffix.size(), suffix.size(), suffix) != 0) continue;
-                if (want_mouse && !c.has_rel_xy) continue;
-                if (!want_mouse && !c.has_keys) continue;
-                typed.push_back(&c);
-            }
-            if (typed.empty()) return std::string{};
-            int rix = 0;
-            for (const auto& r : rules) {
-                ++rix; if (r.empty()) continue;
-                for (const auto* pc : typed) {
-                    if (contains_ci(pc->base, r) || (!pc->name.empty() && contains_ci(pc->name, r))) {
-                        reason = std::string("rule ") + std::to_string(rix) + std::string(" ('") + r + std::string("')");
-                        return pc->path;
-                    }
-                }
-            }
-            return std::string{};
-        };
-
-        auto choose_with_fallbacks = [&](const std::vector<Candidate>& pool, bool want_mouse, const std::vector<std::string>& rules, std::string& reason){
-            return choose_ordered(pool, want_mouse, rules, reason);
-        };
-
+    // Fills whichever of tp_out/kbd_out is still auto from the given pools.
+    auto select_from = [&](const std::vector<Candidate>& id, const std::vector<Candidate>& ppath,
+                           std::string& tp_out, std::string& kbd_out){
         auto fill_one = [&](bool is_tp, std::string& out){
             if (!(out.empty() || to_lower(out) == std::string("auto"))) return;
             std::string why;
             if (policy == MissingPolicy::FALLBACK) {
-                std::string guess = choose_with_fallbacks(id, is_tp, is_tp ? args.tp_matches : args.kbd_matches, why);
-                if (guess.empty()) guess = choose_with_fallbacks(ppath, is_tp, is_tp ? args.tp_matches : args.kbd_matches, why);
+                std::string guess = choose_candidate(id, is_tp, is_tp ? args.tp_matches : args.kbd_matches, true, why);
+                if (guess.empty()) guess = choose_candidate(ppath, is_tp, is_tp ? args.tp_matches : args.kbd_matches, true, why);
                 if (!guess.empty()) {
                     out = guess;
                     std::cout << "[choose] " << (is_tp?"TP":"KBD") << ": " << out << " via " << (why.empty()?"fallback":why) << std::endl;
@@ -498,8 +1728,8 @@ int main(int argc, char** argv) {
                 return;
             }
             const auto& rules = is_tp ? args.tp_matches : args.kbd_matches;
-            std::string guess = choose_rules_only(id, is_tp, rules, why);
-            if (guess.empty()) guess = choose_rules_only(ppath, is_tp, rules, why);
+            std::string guess = choose_candidate(id, is_tp, rules, false, why);
+            if (guess.empty()) guess = choose_candidate(ppath, is_tp, rules, false, why);
             if (!guess.empty()) {
                 out = guess;
                 std::cout << "[choose] " << (is_tp?"TP":"KBD") << ": " << out << " via " << (why.empty()?"rule":why) << std::endl;
@@ -508,9 +1738,146 @@ int main(int argc, char** argv) {
 
         fill_one(true, tp_out);
         fill_one(false, kbd_out);
+        return !tp_out.empty() && !kbd_out.empty() && !equals_ci(tp_out, "auto") && !equals_ci(kbd_out, "auto");
+    };
+
+    auto autodetect = [&](std::string& tp_out, std::string& kbd_out){
+        auto id = scan_symlinks("/dev/input/by-id", "by-id");
+        auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
+        print_candidates("/dev/input/by-id", id);
+        print_candidates("/dev/input/by-path", ppath);
+        return select_from(id, ppath, tp_out, kbd_out);
+    };
+
+    // --tp-all: every other pointing device matching a rule joins the primary
+    // TP with the same map. by-id and by-path links to one node count once.
+    auto add_tp_matches = [&](){
+        auto node = [](const std::string& p){ std::error_code ec; return fs::canonical(p, ec); };
+        std::vector<fs::path> seen{node(args.tp_path)};
+        for (const auto& t : args.tp_extra) seen.push_back(node(t.path));
+        for (const auto& pool : {scan_symlinks("/dev/input/by-id", "by-id"), scan_symlinks("/dev/input/by-path", "by-path")}) {
+            for (const auto& c : pool) {
+                if (!is_capable(c, true) || !match_rules(c, args.tp_matches)) continue;
+                auto n = node(c.path);
+                if (n.empty() || std::find(seen.begin(), seen.end(), n) != seen.end()) continue;
+                seen.push_back(n);
+                args.tp_extra.push_back(TpSpec{c.path, args.tp_map});
+                std::cout << "[choose] TP+: " << c.path << std::endl;
+            }
+        }
+    };
+
+    // --on-missing=fallback: the first capable device of each kind still
+    // unset, by-id before by-path.
+    auto fallback_first = [&](std::string& tp_out, std::string& kbd_out){
+        auto id = scan_symlinks("/dev/input/by-id", "by-id");
+        auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
+        if (tp_out.empty()) tp_out = first_capable(id, true);
+        if (tp_out.empty()) tp_out = first_capable(ppath, true);
+        if (kbd_out.empty()) kbd_out = first_capable(id, false);
+        if (kbd_out.empty()) kbd_out = first_capable(ppath, false);
         return !tp_out.empty() && !kbd_out.empty();
     };
 
+    // --on-missing=wait: keep the pools of one scan and patch them from the
+    // inotify records, so only nodes that were added, removed or changed are
+    // probed and the rules are re-matched in memory. Sleeps in poll() with no
+    // timeout other than the --wait-secs deadline.
+    auto wait_for_rules = [&](std::string& tp_out, std::string& kbd_out){
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) { perror("inotify_init1"); return false; }
+        const uint32_t mask = IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO;
+        struct Dir { std::string path; std::string origin; std::vector<Candidate>* pool; };
+        std::vector<Candidate> id, ppath;
+        std::map<int, Dir> dirs;
+        const int root_wd = inotify_add_watch(fd, "/dev/input", mask);
+        auto watch_dir = [&](const std::string& path, const std::string& origin, std::vector<Candidate>& pool){
+            int wd = inotify_add_watch(fd, path.c_str(), mask);
+            if (wd < 0) return;
+            dirs[wd] = Dir{path, origin, &pool};
+            pool = scan_symlinks(path, origin);
+        };
+        watch_dir("/dev/input/by-id", "by-id", id);
+        watch_dir("/dev/input/by-path", "by-path", ppath);
+
+        auto find = [](std::vector<Candidate>& pool, const std::string& base){
+            return std::find_if(pool.begin(), pool.end(), [&](const Candidate& c){ return c.base == base; });
+        };
+        auto upsert = [&](const Dir& d, const std::string& base){
+            Candidate c{d.path + "/" + base, base, d.origin, std::string(), false, false};
+            evdev_caps(c.path, c.name, c.has_rel_xy, c.has_keys);
+            auto it = find(*d.pool, base);
+            if (it != d.pool->end()) { *it = c; return; }
+            std::cout << "[wait] + " << c.path << "  name='" << c.name << "'" << std::endl;
+            auto pos = std::lower_bound(d.pool->begin(), d.pool->end(), c, [](const Candidate& a, const Candidate& b){ return a.base < b.base; });
+            d.pool->insert(pos, c);
+        };
+        auto remove = [&](const Dir& d, const std::string& base){
+            auto it = find(*d.pool, base);
+            if (it == d.pool->end()) return;
+            std::cout << "[wait] - " << it->path << std::endl;
+            d.pool->erase(it);
+        };
+        // An event node changed (udev finished setting it up): refresh the
+        // links that resolve to it.
+        auto refresh_node = [&](const std::string& node){
+            for (auto* pool : {&id, &ppath}) {
+                for (auto& c : *pool) {
+                    std::error_code ec;
+                    if (fs::canonical(c.path, ec) == fs::path(node)) evdev_caps(c.path, c.name, c.has_rel_xy, c.has_keys);
+                }
+            }
+        };
+
+        const int64_t deadline = args.wait_secs > 0 ? monotonic_ns() + args.wait_secs * 1000000000LL : 0;
+        bool ok = select_from(id, ppath, tp_out, kbd_out);
+        if (!ok) std::cout << "[wait] waiting for a device matching the rules" << std::endl;
+        alignas(inotify_event) char buf[4096];
+        while (!ok) {
+            int timeout = -1;
+            if (deadline) {
+                int64_t left = deadline - monotonic_ns();
+                if (left <= 0) break;
+                timeout = static_cast<int>((left + 999999) / 1000000);
+            }
+            pollfd p{}; p.fd = fd; p.events = POLLIN;
+            if (poll(&p, 1, timeout) <= 0) continue;
+            ssize_t n;
+            while ((n = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* q = buf; q < buf + n; q += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(q)->len) {
+                    const auto* ev = reinterpret_cast<const inotify_event*>(q);
+                    const std::string name = ev->len ? ev->name : "";
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        for (auto& d : dirs) *d.second.pool = scan_symlinks(d.second.path, d.second.origin);
+                        continue;
+                    }
+                    if (ev->wd == root_wd) {
+                        if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                            if (name == "by-id") watch_dir("/dev/input/by-id", "by-id", id);
+                            else if (name == "by-path") watch_dir("/dev/input/by-path", "by-path", ppath);
+                        } else if (name.rfind("event", 0) == 0 && !(ev->mask & (IN_DELETE | IN_MOVED_FROM))) {
+                            refresh_node("/dev/input/" + name);
+                        }
+                        continue;
+                    }
+                    auto it = dirs.find(ev->wd);
+                    if (it == dirs.end()) continue;
+                    if (ev->mask & IN_IGNORED) {
+                        it->second.pool->clear();
+                        dirs.erase(it);
+                        continue;
+                    }
+                    if (name.find("event-") == std::string::npos) continue;
+                    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) remove(it->second, name);
+                    else upsert(it->second, name);
+                }
+            }
+            ok = select_from(id, ppath, tp_out, kbd_out);
+        }
+        close(fd);
+        return ok;
+    };
+
     if (args.list_devices) {
         auto id = scan_symlinks("/dev/input/by-id", "by-id");
         auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
@@ -520,7 +1887,7 @@ int main(int argc, char** argv) {
     }
 
     if (args.install) {
-        if (!g_show_install) {
+        if (!show_install()) {
             std::cerr << "install option is not available for the installed binary" << std::endl;
             usage(argv[0]);
         }
@@ -531,23 +1898,10 @@ int main(int argc, char** argv) {
             bool ok = autodetect(tp_guess, kbd_guess);
             if (!ok) {
                 if (args.on_missing == "fallback") {
-                    auto id = scan_symlinks("/dev/input/by-id", "by-id");
-                    auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
-                    for (const auto& c : id) if (tp_guess.empty() && c.base.size()>=12 && c.base.compare(c.base.size()-12,12,"-event-mouse")==0 && c.has_rel_xy) { tp_guess = c.path; break; }
-                    for (const auto& c : ppath) if (tp_guess.empty() && c.base.size()>=12 && c.base.compare(c.base.size()-12,12,"-event-mouse")==0 && c.has_rel_xy) { tp_guess = c.path; break; }
-                    for (const auto& c : id) if (kbd_guess.empty() && c.base.size()>=10 && c.base.compare(c.base.size()-10,10,"-event-kbd")==0 && c.has_keys) { kbd_guess = c.path; break; }
-                    for (const auto& c : ppath) if (kbd_guess.empty() && c.base.size()>=10 && c.base.compare(c.base.size()-10,10,"-event-kbd")==0 && c.has_keys) { kbd_guess = c.path; break; }
-                    ok = !tp_guess.empty() && !kbd_guess.empty();
+                    ok = fallback_first(tp_guess, kbd_guess);
                     if (ok) std::cout << "[fallback] selected first capable devices" << std::endl;
                 } else if (args.on_missing == "wait") {
-                    int fdw = inotify_fd();
-                    int waited = 0;
-                    while (!ok && (args.wait_secs == 0 || waited < args.wait_secs)) {
-                        wait_change_or_timeout(fdw, 1000);
-                        waited += 1;
-                        ok = autodetect(tp_guess, kbd_guess);
-                    }
-                    if (fdw >= 0) close(fdw);
+                    ok = wait_for_rules(tp_guess, kbd_guess);
                 } else if (args.on_missing == "interactive" && isatty(STDIN_FILENO)) {
                     auto id = scan_symlinks("/dev/input/by-id", "by-id");
                     auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
@@ -585,7 +1939,12 @@ int main(int argc, char** argv) {
             std::cout << "[install] autodetected TP: " << args.tp_path << "\n";
             std::cout << "[install] autodetected KBD: " << args.kbd_path << "\n";
         }
+        // Resolved now: the unit gets the explicit device list.
+        if (args.tp_all) add_tp_matches();
         if (!fs::exists(args.tp_path)) { std::cerr << "tp path not found: " << args.tp_path << std::endl; return EXIT_FAILURE; }
+        for (const auto& t : args.tp_extra) {
+            if (!fs::exists(t.path)) { std::cerr << "tp path not found: " << t.path << std::endl; return EXIT_FAILURE; }
+        }
         if (!fs::exists(args.kbd_path)) { std::cerr << "kbd path not found: " << args.kbd_path << std::endl; return EXIT_FAILURE; }
         if (!run_cmd_ok("command -v systemctl >/dev/null 2>&1", "systemctl availability check")) {
             std::cerr << "systemctl not available; systemd required for --install" << std::endl;
@@ -594,7 +1953,7 @@ int main(int argc, char** argv) {
         std::string unit_path = "/etc/systemd/system/" + args.service_name + ".service";
         if (fs::exists(unit_path)) {
             std::cerr << "already installed: " << unit_path << " exists; refusing to reinstall" << std::endl;
-            std::cerr << "edit the env file and restart the service if you need changes." << std::endl;
+            std::cerr << "edit the env file; tuning applies on save, device changes need a restart." << std::endl;
             return EXIT_FAILURE;
         }
         std::string self = read_self_path();
@@ -613,10 +1972,40 @@ int main(int argc, char** argv) {
         {
             std::ofstream ef(env_path, std::ios::out | std::ios::trunc);
             if (!ef) { std::cerr << "failed to write env file: " << env_path << std::endl; return EXIT_FAILURE; }
-            ef << "TP_EVENT=" << args.tp_path << "\n";
+            std::string tp_env = args.tp_path + (args.tp_map.empty() ? "" : "@" + args.tp_map);
+            for (const auto& t : args.tp_extra) tp_env += ";" + t.path + (t.map.empty() ? "" : "@" + t.map);
+            ef << "TP_EVENT=" << tp_env << "\n";
             ef << "KBD_EVENT=" << args.kbd_path << "\n";
             ef << "GAIN=" << args.gain << "\n";
+            ef << "DEADZONE=" << args.deadzone << "\n";
             ef << "HOTKEY=" << args.hotkey << "\n";
+            std::string curve_env;
+            for (const auto& c : args.curves) curve_env += (curve_env.empty() ? "" : ";") + c;
+            ef << "CURVE=" << curve_env << "\n";
+            std::string modes_env;
+            for (const auto& m : args.modes) modes_env += (modes_env.empty() ? "" : ";") + m;
+            ef << "MODES=" << modes_env << "\n";
+            std::string chords_env;
+            for (const auto& c : args.chords) chords_env += (chords_env.empty() ? "" : ";") + c;
+            ef << "CHORDS=" << chords_env << "\n";
+            ef << "PRECISION=" << args.precision << "\n";
+            ef << "AXIS_LOCK=" << args.axis_lock << "\n";
+            ef << "RATE_HZ=" << args.rate_hz << "\n";
+            ef << "DECAY_MS=" << args.decay_ms << "\n";
+            ef << "PREDICT_MS=" << args.predict_ms << "\n";
+            ef << "FILTER=" << args.filter << "\n";
+            ef << "WHEEL=" << args.wheel << "\n";
+            ef << "LOG_LEVEL=" << args.log_level << "\n";
+            ef << "MLOCK=" << (args.mlock ? "1" : "") << "\n";
+            ef << "KBD_GRAB=" << (args.kbd_grab ? "1" : "") << "\n";
+            ef << "AXIS_RANGE=" << args.axis_range << "\n";
+            ef << "ABS_FUZZ=" << args.abs_fuzz << "\n";
+            ef << "ABS_FLAT=" << args.abs_flat << "\n";
+            ef << "ABS_RES=" << args.abs_res << "\n";
+            ef << "OUTPUT=" << args.output << "\n";
+            ef << "SPNAV_SOCKET=" << (args.output == "spnav" ? args.spnav_socket : "") << "\n";
+            ef << "UINPUT_NAME=" << args.uinput_name << "\n";
+            ef << "UINPUT_ID=" << args.uinput_id << "\n";
             ef.flush();
             if (!ef) { std::cerr << "failed to flush env file: " << env_path << std::endl; return EXIT_FAILURE; }
         }
@@ -628,12 +2017,28 @@ int main(int argc, char** argv) {
             uf << "[Unit]\n";
             uf << "Description=TrackPoint 3D mouse emulation\n";
             uf << "After=local-fs.target\n";
-            uf << "ConditionPathExists=/dev/uinput\n\n";
+            if (args.output == "spnav") uf << "Conflicts=spacenavd.service\n\n";
+            else uf << "ConditionPathExists=/dev/uinput\n\n";
             uf << "[Service]\n";
             uf << "Type=simple\n";
-            uf << "EnvironmentFile=" << env_path << "\n";
-            uf << "ExecStart=/bin/sh -c 'exec \"" << args.install_path
-               << "\" --tp \"${TP_EVENT}\" --kbd \"${KBD_EVENT}\" ${GAIN:+--gain \"${GAIN}\"} ${HOTKEY:+--hotkey \"${HOTKEY}\"}'\n";
+            // The daemon reads the env file itself, so tuning changes apply
+            // with `systemctl reload` (or on save) without recreating uinput.
+            uf << "ExecStart=\"" << args.install_path << "\" --config \"" << env_path << "\"\n";
+            uf << "ExecReload=/bin/kill -HUP $MAINPID\n";
+            // Scheduling is applied by systemd before exec.
+            if (args.rt_priority > 0) {
+                uf << "CPUSchedulingPolicy=" << args.rt_policy << "\n";
+                uf << "CPUSchedulingPriority=" << args.rt_priority << "\n";
+            }
+            if (!args.cpus.empty()) {
+                std::vector<int> cpus;
+                parse_cpu_list(args.cpus, cpus);
+                uf << "CPUAffinity=";
+                for (size_t i = 0; i < cpus.size(); ++i) uf << (i ? " " : "") << cpus[i];
+                uf << "\n";
+            }
+            if (args.nice != 0) uf << "Nice=" << args.nice << "\n";
+            if (args.mlock) uf << "LimitMEMLOCK=infinity\n";
             uf << "Restart=on-failure\n";
             uf << "RestartSec=2s\n\n";
             uf << "[Install]\n";
@@ -650,29 +2055,21 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    if (args.auto_detect || args.tp_path.empty() || args.kbd_path.empty() || equals_ci(args.tp_path, "auto") || equals_ci(args.kbd_path, "auto")) {
+    // Seats name their devices; there is nothing to detect.
+    if (args.seats.empty() && (args.auto_detect || args.tp_path.empty() || args.kbd_path.empty() || equals_ci(args.tp_path, "auto") || equals_ci(args.kbd_path, "auto"))) {
         std::string tp_guess = args.tp_path;
         std::string kbd_guess = args.kbd_path;
-        bool ok = autodetect(tp_guess, kbd_guess);
+        // --tp-all has to look at every node anyway.
+        const bool use_cache = !args.tp_all && !args.selection_cache.empty() && args.selection_cache != "none";
+        const std::string rules = selection_rules(args, tp_auto_engaged(), kbd_auto_engaged());
+        const bool cached = use_cache && load_selection(args.selection_cache, rules, tp_auto_engaged(), kbd_auto_engaged(), tp_guess, kbd_guess);
+        bool ok = cached || autodetect(tp_guess, kbd_guess);
         if (!ok) {
             if (args.on_missing == "fallback") {
-                auto id = scan_symlinks("/dev/input/by-id", "by-id");
-                auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
-                for (const auto& c : id) if (tp_guess.empty() && c.base.size()>=12 && c.base.compare(c.base.size()-12,12,"-event-mouse")==0 && c.has_rel_xy) { tp_guess = c.path; break; }
-                for (const auto& c : ppath) if (tp_guess.empty() && c.base.size()>=12 && c.base.compare(c.base.size()-12,12,"-event-mouse")==0 && c.has_rel_xy) { tp_guess = c.path; break; }
-                for (const auto& c : id) if (kbd_guess.empty() && c.base.size()>=10 && c.base.compare(c.base.size()-10,10,"-event-kbd")==0 && c.has_keys) { kbd_guess = c.path; break; }
-                for (const auto& c : ppath) if (kbd_guess.empty() && c.base.size()>=10 && c.base.compare(c.base.size()-10,10,"-event-kbd")==0 && c.has_keys) { kbd_guess = c.path; break; }
-                ok = !tp_guess.empty() && !kbd_guess.empty();
+                ok = fallback_first(tp_guess, kbd_guess);
                 if (ok) std::cout << "[fallback] selected first capable devices" << std::endl;
             } else if (args.on_missing == "wait") {
-                int fdw = inotify_fd();
-                int waited = 0;
-                while (!ok && (args.wait_secs == 0 || waited < args.wait_secs)) {
-                    wait_change_or_timeout(fdw, 1000);
-                    waited += 1;
-                    ok = autodetect(tp_guess, kbd_guess);
-                }
-                if (fdw >= 0) close(fdw);
+                ok = wait_for_rules(tp_guess, kbd_guess);
             } else if (args.on_missing == "interactive" && isatty(STDIN_FILENO)) {
                 auto id = scan_symlinks("/dev/input/by-id", "by-id");
                 auto ppath = scan_symlinks("/dev/input/by-path", "by-path");
@@ -708,137 +2105,222 @@ int main(int argc, char** argv) {
             std::cerr << "autodetect failed; please pass --tp and --kbd or connect devices." << std::endl;
             return EXIT_FAILURE;
         }
+        if (use_cache && !cached) save_selection(args.selection_cache, rules, tp_guess, kbd_guess);
         args.tp_path = tp_guess;
         args.kbd_path = kbd_guess;
-        std::cout << "[auto] TP:  " << args.tp_path << "\n";
-        std::cout << "[auto] KBD: " << args.kbd_path << "\n";
+        std::cout << "[auto] TP:  " << args.tp_path << (cached ? " (cached)" : "") << "\n";
+        std::cout << "[auto] KBD: " << args.kbd_path << (cached ? " (cached)" : "") << "\n";
     }
-    if (args.tp_path.empty() || args.kbd_path.empty()) { usage(argv[0]); }
+    if (args.tp_all) {
+        add_tp_matches();
+        // The TPs it added need their maps as well.
+        std::string err;
+        if (args.seats.empty() && !build_seat_config(args, cfg, err)) error_and_usage(err);
+    }
+    if (args.seats.empty() && (args.tp_path.empty() || args.kbd_path.empty())) { usage(argv[0]); }
     if (geteuid() != 0) {
         std::cerr << "run as root" << std::endl;
         return EXIT_FAILURE;
     }
+    if (args.calibrate) {
+        std::string env_path = !args.config_path.empty() ? args.config_path : args.env_dir + std::string("/") + DEFAULT_ENV_FILE;
+        return run_calibration(args, env_path);
+    }
 
-    signal(SIGINT, sigint_handler);
-    signal(SIGTERM, sigint_handler);
-
-    int ufd = setup_uinput();
-
-    auto open_evdev = [](const std::string& path) {
-        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-        if (fd < 0) {
-            perror("open evdev");
+    // One seat per --seat file, else the single one the options describe.
+    std::vector<std::unique_ptr<Seat>> seats;
+    if (args.seats.empty()) {
+        auto s = std::make_unique<Seat>();
+        s->args = args;
+        s->overrides = cli;
+        s->loaded_env = loaded_env;
+        s->cfg = cfg;
+        s->owns_log_level = true;
+        seats.push_back(std::move(s));
+    }
+    for (const auto& path : args.seats) {
+        auto fail = [&](const std::string& msg) {
+            std::cerr << "seat " << path << ": " << msg << std::endl;
             std::exit(EXIT_FAILURE);
+        };
+        auto s = std::make_unique<Seat>();
+        const std::string stem = fs::path(path).stem().string();
+        if (!read_env_file(path, s->loaded_env)) fail(std::string("cannot read: ") + std::strerror(errno));
+        try {
+            s->args = parse_args(env_to_args(s->loaded_env), argv[0]);
+        } catch (const std::exception&) {
+            fail("bad number");
         }
-        libevdev* dev = nullptr;
-        if (libevdev_new_from_fd(fd, &dev) < 0) {
-            std::cerr << "failed to init libevdev on " << path << std::endl;
-            std::exit(EXIT_FAILURE);
+        s->args.config_path = path;
+        auto named = s->loaded_env.find("UINPUT_NAME");
+        if (named == s->loaded_env.end() || named->second.empty()) s->args.uinput_name = std::string(DEFAULT_UINPUT_NAME) + " " + stem;
+        if (s->args.tp_path.empty() || s->args.kbd_path.empty() || equals_ci(s->args.tp_path, "auto") || equals_ci(s->args.kbd_path, "auto")) {
+            fail("TP_EVENT and KBD_EVENT must name devices");
         }
-        return dev;
-    };
-
-    libevdev* tp_dev = open_evdev(args.tp_path);
-    libevdev* kbd_dev = open_evdev(args.kbd_path);
-
-    std::unordered_set<int> keys_down;
-    std::mutex keys_mtx;
-    bool grabbed = false;
-    Mode last_mode = Mode::ORBIT;
-
-    std::thread kbd_thread([&] {
-        input_event ev;
-        while (running) {
-            int rc = libevdev_next_event(kbd_dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-            if (rc == 0 && ev.type == EV_KEY) {
-                std::lock_guard<std::mutex> lock(keys_mtx);
-                if (ev.value)
-                    keys_down.insert(ev.code);
-                else
-                    keys_down.erase(ev.code);
-
-                if (ev.code == args.hotkey && ev.value == 1) {
-                    if (grabbed) {
-                        libevdev_grab(tp_dev, LIBEVDEV_UNGRAB);
-                        grabbed = false;
-                        zero_all_axes(ufd);
-                        std::cout << "[toggle] OFF" << std::endl;
-                    } else {
-                        libevdev_grab(tp_dev, LIBEVDEV_GRAB);
-                        grabbed = true;
-                        std::cout << "[toggle] ON" << std::endl;
-                    }
-                }
-            } else if (rc == -EAGAIN) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::string err;
+        if (!build_seat_config(s->args, s->cfg, err)) fail(err);
+        for (const auto& o : seats) {
+            if (s->args.output == "uinput" && o->args.output == "uinput" && o->cfg.ident.name == s->cfg.ident.name) {
+                fail("uinput name '" + s->cfg.ident.name + "' is already used by " + o->args.config_path);
+            }
+            if (s->args.output == "spnav" && o->args.output == "spnav" && o->args.spnav_socket == s->args.spnav_socket) {
+                fail("spnav socket " + s->args.spnav_socket + " is already used by " + o->args.config_path);
             }
         }
-    });
-
-    input_event ev;
-    while (running) {
-        int rc = libevdev_next_event(tp_dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-        if (rc == 0 && grabbed && ev.type == EV_REL) {
-            int dx = (ev.code == REL_X) ? ev.value : 0;
-            int dy = (ev.code == REL_Y) ? ev.value : 0;
-
-            if (std::abs(dx) < DEADZONE) dx = 0;
-            if (std::abs(dy) < DEADZONE) dy = 0;
-            if (dx == 0 && dy == 0) continue;
+        s->id = static_cast<uint32_t>(seats.size());
+        s->tag = "[" + stem + "] ";
+        seats.push_back(std::move(s));
+    }
+    if (!args.seats.empty()) {
+        // Every seat's devices in one concurrent probe pass.
+        std::vector<std::string> paths;
+        for (const auto& s : seats) {
+            paths.push_back(s->args.kbd_path);
+            paths.push_back(s->args.tp_path);
+            for (const auto& t : s->args.tp_extra) paths.push_back(t.path);
+        }
+        probes.prefetch(paths);
+        for (const auto& s : seats) {
+            auto check = [&](const std::string& p, bool tp) {
+                const Probe& pr = probes.get(p);
+                if (tp ? pr.has_rel_xy : pr.has_keys) return;
+                std::cerr << "seat " << s->args.config_path << ": " << p << (tp ? " is not a pointing device" : " has no keys") << std::endl;
+                std::exit(EXIT_FAILURE);
+            };
+            check(s->args.kbd_path, false);
+            check(s->args.tp_path, true);
+            for (const auto& t : s->args.tp_extra) check(t.path, true);
+        }
+    }
 
-            if (dx && dy) {
-                double scale = std::max(std::abs(dx), std::abs(dy)) /
-                                ((std::abs(dx) + std::abs(dy)) / std::sqrt(2.0));
-                dx = static_cast<int>(dx * scale);
-                dy = static_cast<int>(dy * scale);
-            }
+    int sfd = make_signalfd({SIGINT, SIGTERM, SIGUSR1, SIGHUP});
+    if (sfd < 0) return EXIT_FAILURE;
 
-            int sx = static_cast<int>(dx * args.gain);
-            int sy = static_cast<int>(dy * args.gain);
+    Shared sh;
+    if (!sh.loop.open()) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+    g_stats.enabled = args.stats;
+    const int64_t start_ns = monotonic_ns();
+    int stats_fd = -1;
+    if (args.stats && args.stats_interval > 0) {
+        stats_fd = make_timerfd();
+        if (stats_fd >= 0) set_timer(stats_fd, args.stats_interval * 1000000000L);
+    }
+    auto dump_stats = [&]() {
+        log_text(LogLevel::INFO, g_stats.json(static_cast<double>(monotonic_ns() - start_ns) / 1e9));
+    };
 
-            bool shift = false, ctrl = false;
-            {
-                std::lock_guard<std::mutex> lock(keys_mtx);
-                shift = keys_down.count(KEY_LEFTSHIFT) || keys_down.count(KEY_RIGHTSHIFT);
-                ctrl = keys_down.count(KEY_LEFTCTRL) || keys_down.count(KEY_RIGHTCTRL);
-            }
+    if (!args.record_path.empty()) {
+        sh.rec = std::fopen(args.record_path.c_str(), "wb");
+        if (!sh.rec) {
+            perror("open --record file");
+            return EXIT_FAILURE;
+        }
+        RecordHeader hdr{};
+        std::memcpy(hdr.magic, RECORD_MAGIC, sizeof(hdr.magic));
+        hdr.version = 1;
+        hdr.hotkey = args.hotkey;
+        std::fwrite(&hdr, sizeof(hdr), 1, sh.rec);
+        std::cout << "[record] " << args.record_path << std::endl;
+    }
 
-            Mode mode = Mode::ORBIT;
-            if (shift)
-                mode = Mode::TILT;
-            else if (ctrl)
-                mode = Mode::PAN;
+    for (auto& s : seats) {
+        s->sh = &sh;
+        s->prog = argv[0];
+        if (!s->open()) return EXIT_FAILURE;
+        if (!s->tag.empty()) std::cout << s->tag << s->cfg.ident.name << ": TP " << s->args.tp_path << ", KBD " << s->args.kbd_path << std::endl;
+    }
+    int hotplug_fd = inotify_fd();
+    if (!sh.loop.add(sfd, SRC_SIGNAL) ||
+        (hotplug_fd >= 0 && !sh.loop.add(hotplug_fd, SRC_HOTPLUG)) ||
+        (stats_fd >= 0 && !sh.loop.add(stats_fd, SRC_STATS))) {
+        return EXIT_FAILURE;
+    }
 
-            if (mode != last_mode) {
-                zero_all_axes(ufd);
-                std::cout << "[mode]: " << mode_name(mode) << std::endl;
-                last_mode = mode;
-            }
+    // Started before the scheduling change so the writer keeps a normal
+    // policy and CPU set instead of inheriting the loop's.
+    log_start();
+    if (!apply_scheduling(args)) return EXIT_FAILURE;
 
-            if (mode == Mode::TILT) {
-                emit(ufd, EV_ABS, ABS_RY, clamp(-sx), false);
-                emit(ufd, EV_ABS, ABS_Y, clamp(-sy));
-            } else if (mode == Mode::PAN) {
-                emit(ufd, EV_ABS, ABS_X, clamp(sx), false);
-                emit(ufd, EV_ABS, ABS_Z, clamp(-sy));
-            } else { // ORBIT
-                emit(ufd, EV_ABS, ABS_RZ, clamp(-sx), false);
-                emit(ufd, EV_ABS, ABS_RX, clamp(-sy));
+    epoll_event events[8];
+    while (running) {
+        int n = sh.loop.wait(events, 8, -1);
+        Stats::bump(g_stats.wakeups);
+        Stats::bump(g_stats.syscalls);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg(LogLevel::ERROR, "epoll_wait: %s", std::strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint32_t idx = EventLoop::index_of(events[i]);
+            Seat& s = *seats[idx >> 16];
+            switch (EventLoop::kind_of(events[i])) {
+                case SRC_TP: {
+                    Attached& t = s.tps[idx & 0xffff];
+                    if (t.dev) s.drain(t);
+                    break;
+                }
+                case SRC_KBD:
+                    if (s.kbd.dev) s.drain(s.kbd);
+                    break;
+                case SRC_OUTPUT:
+                    s.out->on_readable();
+                    break;
+                case SRC_CONFIG:
+                    s.on_config_readable();
+                    break;
+                case SRC_PASSTHROUGH:
+                    s.on_passthrough_readable();
+                    break;
+                case SRC_HOTPLUG: {
+                    char buf[4096];
+                    while (read(hotplug_fd, buf, sizeof(buf)) > 0) {}
+                    // by-id/by-path may have been (re)created; re-adding an
+                    // existing watch is a no-op.
+                    for (const char* d : {"/dev/input/by-id", "/dev/input/by-path"}) {
+                        inotify_add_watch(hotplug_fd, d, IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO);
+                    }
+                    for (auto& seat : seats) seat->reattach_missing();
+                    break;
+                }
+                case SRC_SIGNAL: {
+                    signalfd_siginfo si;
+                    while (read(sfd, &si, sizeof(si)) == sizeof(si)) {
+                        if (si.ssi_signo == SIGUSR1) {
+                            if (g_stats.enabled) dump_stats();
+                        } else if (si.ssi_signo == SIGHUP) {
+                            for (auto& seat : seats) seat->reload();
+                        } else {
+                            running = false;
+                        }
+                    }
+                    break;
+                }
+                case SRC_TIMER:
+                    s.on_timer();
+                    break;
+                case SRC_STATS: {
+                    uint64_t expirations;
+                    while (read(stats_fd, &expirations, sizeof(expirations)) > 0) {}
+                    dump_stats();
+                    break;
+                }
             }
-        } else if (rc == -EAGAIN) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+        for (auto& seat : seats) if (seat->pipeline.pending()) seat->emit_motion();
     }
 
-    libevdev_grab(tp_dev, LIBEVDEV_UNGRAB);
-    zero_all_axes(ufd);
-
-    ioctl(ufd, UI_DEV_DESTROY);
-    close(ufd);
-
-    kbd_thread.join();
-    libevdev_free(tp_dev);
-    libevdev_free(kbd_dev);
+    for (auto& s : seats) s->close_all();
+    sh.loop.close_all();
+    if (stats_fd >= 0) close(stats_fd);
+    if (sh.rec) std::fclose(sh.rec);
+    close(sfd);
+    if (g_stats.enabled) dump_stats();
+    log_stop();
+    if (hotplug_fd >= 0) close(hotplug_fd);
 
     return 0;
 }